@@ -1,6 +1,27 @@
 // Stepper Settings
 #define STEPS_PER_ROTATION 3200U // 200 * 16 -> Microstepping
 
+// Speed in steps/s and acceleration in steps/s^2 of normal moves
+#define STEPPER_MAX_SPEED 12000
+#define STEPPER_ACCELERATION 12000
+
+// Jerk limited profiles of the hardware step generators in steps/s, steps/s^2 and steps/s^3
+// The matcher runs with less current than the tuner, so it accelerates slower
+// The acceleration builds up over 100ms, that is the first and last 30 steps of a move
+#define TUNER_MAX_SPEED 16000
+#define TUNER_ACCELERATION 20000
+#define TUNER_JERK 200000
+#define MATCHER_MAX_SPEED 16000
+#define MATCHER_ACCELERATION 16000
+#define MATCHER_JERK 160000
+
+// Steps the capacitor shaft lags behind after the stepper changes direction
+#define BACKLASH_STEPS 50U
+
+// Travel of the capacitor shafts after homing, position 0 is the end stop. The lower limit leaves room for the backlash overshoot
+#define STEPPER_MIN_POSITION 50L
+#define STEPPER_MAX_POSITION 80000L // ~25 rotations
+
 // Stall Detection sensitivity
 #define STALL_VALUE 16 // [-64..63]
 
@@ -9,4 +30,5 @@ struct Stepper{
    TMC2130Stepper DRIVER;
    int STALL_PIN;
    String TYPE;
+   StepGenerator *GENERATOR; // nullptr if the steps are generated by AccelStepper::run()
 };
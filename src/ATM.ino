@@ -1,5 +1,7 @@
 #include "global.h"
 
+#include <esp_task_wdt.h>
+
 #include "CommandManager.h"
 #include "commands/FrequencySweep.h"
 #include "commands/TuneMatch.h"
@@ -10,6 +12,11 @@
 #include "commands/ControlSwitch.h"
 #include "commands/MoveStepper.h"
 #include "commands/PositionSweep.h"
+#include "commands/BaudRate.h"
+#include "commands/Sequence.h"
+#include "commands/FetchSweep.h"
+#include "commands/Calibration.h"
+#include "commands/BatchTune.h"
 
 #define DEBUG
 
@@ -27,6 +34,11 @@ VoltageSweep voltageSweep;
 ControlSwitch controlSwitch;
 MoveStepper moveStepper;
 PositionSweep positionSweep;
+BaudRate baudRate;
+Sequence sequence(commandManager);
+FetchSweep fetchSweep;
+Calibration calibration;
+BatchTune batchTune(tuneMatch);
 
 // Frequency Settings
 #define FREQUENCY_STEP 100000U    // 100kHz frequency steps for initial frequency sweep
@@ -41,9 +53,13 @@ TMC2130Stepper matching_driver = TMC2130Stepper(EN_PIN_M2, DIR_PIN_M2, STEP_PIN_
 AccelStepper tuning_stepper = AccelStepper(tuning_stepper.DRIVER, STEP_PIN_M1, DIR_PIN_M1);
 AccelStepper matching_stepper = AccelStepper(matching_stepper.DRIVER, STEP_PIN_M2, DIR_PIN_M2);
 
-Stepper tuner = {tuning_stepper, tuning_driver, DIAG1_PIN_M1, "Tuner"};
+// The direction pins are inverted like in setPinsInverted() below
+StepGenerator tuning_generator = StepGenerator(STEP_PIN_M1, DIR_PIN_M1, true, 0);
+StepGenerator matching_generator = StepGenerator(STEP_PIN_M2, DIR_PIN_M2, true, 1);
+
+Stepper tuner = {tuning_stepper, tuning_driver, DIAG1_PIN_M1, "Tuner", &tuning_generator};
 
-Stepper matcher = {matching_stepper, matching_driver, DIAG1_PIN_M2, "Matcher"};
+Stepper matcher = {matching_stepper, matching_driver, DIAG1_PIN_M2, "Matcher", &matching_generator};
 
 // ADC DAC Module
 
@@ -56,9 +72,37 @@ Filter active_filter = FILTERS[0];
 
 boolean homed = false;
 
+Scheduler scheduler;
+SweepStore sweepStore;
+// Learned tuner and matcher positions, kept in the NVS flash
+CalibrationMap positionMap("positions");
+// Learned tuning and matching voltages of varactor probes
+CalibrationMap voltageMap("voltages");
+// Phases at the resonance of matchings that needed anticlockwise or clockwise matcher rotation
+CalibrationMap anticlockwisePhaseMap("phases_acw");
+CalibrationMap clockwisePhaseMap("phases_cw");
+// Learned effect of the tuner and matcher on the resonance and the matching
+SensitivityMatrix sensitivity;
+// Readings of the current tuning session
+MeasurementCache measurementCache;
+// Executes the stepper moves on the other core
+MotionService motion;
+// Learned time the steppers ring after a move
+SettleModel settleModel;
+
+// The watchdog resets the ESP32 if the firmware hangs for this many seconds
+#define WATCHDOG_TIMEOUT 30
+#define WATCHDOG_FEED_INTERVAL 1000U // ms
+
+// Characters of the current input line that has not been terminated yet
+String serial_input = "";
+
+void handleSerialInput();
+void feedWatchdog();
+
 void setup()
 {
-  Serial.begin(115200);
+  Serial.begin(DEFAULT_BAUD_RATE);
 
   // Here the commands are registered
   commandManager.registerCommand('f', &frequencySweep);
@@ -70,6 +114,11 @@ void setup()
   commandManager.registerCommand('c', &controlSwitch);
   commandManager.registerCommand('m', &moveStepper);
   commandManager.registerCommand('p', &positionSweep);
+  commandManager.registerCommand('b', &baudRate);
+  commandManager.registerCommand('q', &sequence);
+  commandManager.registerCommand('g', &fetchSweep);
+  commandManager.registerCommand('k', &calibration);
+  commandManager.registerCommand('l', &batchTune);
 
   pinMode(MISO_PIN, INPUT_PULLUP); // Seems to be necessary for SPI to work
 
@@ -100,14 +149,14 @@ void setup()
   digitalWrite(EN_PIN_M1, LOW);
   digitalWrite(EN_PIN_M2, LOW);
 
-  tuner.STEPPER.setMaxSpeed(12000);
-  tuner.STEPPER.setAcceleration(12000);
+  tuner.STEPPER.setMaxSpeed(STEPPER_MAX_SPEED);
+  tuner.STEPPER.setAcceleration(STEPPER_ACCELERATION);
   tuner.STEPPER.setEnablePin(EN_PIN_M1);
   tuner.STEPPER.setPinsInverted(true, false, true);
   tuner.STEPPER.enableOutputs();
 
-  matcher.STEPPER.setMaxSpeed(12000);
-  matcher.STEPPER.setAcceleration(12000);
+  matcher.STEPPER.setMaxSpeed(STEPPER_MAX_SPEED);
+  matcher.STEPPER.setAcceleration(STEPPER_ACCELERATION);
   matcher.STEPPER.setEnablePin(EN_PIN_M2);
   matcher.STEPPER.setPinsInverted(true, false, true);
   matcher.STEPPER.enableOutputs();
@@ -116,6 +165,21 @@ void setup()
 
   matcher.STEPPER.setCurrentPosition(0);
 
+  // Without a step generator the moves fall back to AccelStepper::run()
+  if (!tuning_generator.begin(TUNER_MAX_SPEED, TUNER_ACCELERATION, TUNER_JERK))
+  {
+    DEBUG_PRINT("Could not start the step generator of the tuner");
+    tuner.GENERATOR = nullptr;
+  }
+  if (!matching_generator.begin(MATCHER_MAX_SPEED, MATCHER_ACCELERATION, MATCHER_JERK))
+  {
+    DEBUG_PRINT("Could not start the step generator of the matcher");
+    matcher.GENERATOR = nullptr;
+  }
+  // The motion task attaches the step timers, so the step interrupts run on its core
+  if (!motion.begin())
+    DEBUG_PRINT("Could not start the motion task");
+
   // Setup for the ADF4351 frequency synthesizer
   adf4351.begin();
 
@@ -139,25 +203,61 @@ void setup()
   adac.write_DAC(VT, 0.0);
 
   adac.configure_ADCs(ADCs);
+
+  if (!sweepStore.begin())
+    DEBUG_PRINT("Could not allocate the sweep store");
+
+  positionMap.begin();
+  voltageMap.begin();
+  anticlockwisePhaseMap.begin();
+  clockwisePhaseMap.begin();
+
+  // Tasks of the scheduler
+  // The serial input is only handled from loop() and not while a command is executed
+  scheduler.addTask(handleSerialInput, 0);
+  scheduler.addTask(feedWatchdog, WATCHDOG_FEED_INTERVAL, true);
+
+  esp_task_wdt_init(WATCHDOG_TIMEOUT, true);
+  esp_task_wdt_add(NULL);
 }
 
 
 void loop()
+{
+  // Everything is done by the tasks of the scheduler, see setup()
+  scheduler.run();
+}
+
+void handleSerialInput()
 {
   // Serial communication via USB.
   // Commands:
-  // f<start frequency>f<stop frequency>f<frequency step> - Frequency Sweep
-  // d<target frequency in MHz>f<start frequency>f<stop frequency>f<frequency step> - Tune and Match
+  // f<start frequency>f<stop frequency>f<frequency step> - Frequency Sweep, a trailing 'c' sends the data in the compact delta encoded format (see SweepEncoder.h)
+  // d<target frequency in MHz><strategy> - Tune and Match. Strategy 'a' alternates tuning and matching (default), 'j' searches both positions jointly, 't' tracks from the last target, 'o' moves by the fitted resonator model. After homing the search starts from the learned positions.
   // h - Homing
   // v<VM voltage in V>v<VT voltage in V> - Set Voltages
   // r<frequency in MHz> - Measure Reflection
   // s<start voltage in V>s<stop voltage in V>s<voltage step in V> - Voltage Sweep
   // c<filter identifier> - Control Switch for the filterbank 'p' stands for preamplifier and 'a' for automatic tuning and matching. 
   // m<stepper identifier><steps> - Move stepper motor. 't' for tuner and 'm' for matcher. Positive steps move the stepper away from the motor and negative steps move the stepper towards the motor.
-  // p<tuning range in steps>t<tuning step in steps>t<tuning backlash in steps>m<matching range in steps>m<matching step in steps>m<matching backlash in steps> - Position Sweep
-  if (Serial.available())
+  // p<tuning range in steps>t<tuning step in steps>t<tuning backlash in steps>m<matching range in steps>m<matching step in steps>m<matching backlash in steps> - Position Sweep, a trailing 'r' starts coarse and refines around the best position, a trailing 'c' measures while the matcher moves
+  // b<baud rate> - Switch the serial link to a faster baud rate. The PC has to echo b<baud rate> at the new rate, otherwise the old rate is restored. 'b' alone prints the active rate.
+  // q+<command line> / qf<frequency in MHz>,<frequency in MHz>,... / qr / ql / qc - Add a line to / set the frequency loop of / run / list / clear the stored command sequence. $f is replaced by the loop frequency in MHz, $h in Hz.
+  // g<sweep id>,<first point>,<last point>,<decimation><view> / gs<sweep id> / gl - Fetch the data or a summary of a stored frequency sweep, list the stored sweeps.
+  // k<map> / k<map>c / k<map>e / k<map>i<data> - List / clear / export / import a learned calibration map. Map 'p' holds the tuner and matcher positions, 'v' the tuning and matching voltages.
+  // l<frequency in MHz>,<frequency in MHz>,... - Tune and match to all frequencies in the order of the tuner position, the result lines n<index>... carry the index in the list.
+  // The input is collected without blocking so the scheduler keeps running while a line arrives
+  while (Serial.available())
   {
-    String input_line = Serial.readStringUntil('\n'); // read string until newline character
+    char received = Serial.read();
+    if (received != '\n')
+    {
+      serial_input += received;
+      continue;
+    }
+
+    String input_line = serial_input;
+    serial_input = "";
 
     char command = input_line.charAt(0); // gets first character of input
 
@@ -200,3 +300,8 @@ void loop()
   }
 }
 
+void feedWatchdog()
+{
+  esp_task_wdt_reset();
+}
+
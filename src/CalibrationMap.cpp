@@ -0,0 +1,198 @@
+#include "CalibrationMap.h"
+
+// Key of the points blob in the NVS namespace of the map
+#define CALIBRATION_KEY "points"
+
+CalibrationMap::CalibrationMap(const char *name) : name(name)
+{
+}
+
+boolean CalibrationMap::begin()
+{
+    Preferences preferences;
+    if (!preferences.begin(name, true))
+        return false;
+
+    // A blob that does not fit the current point layout is ignored
+    size_t length = preferences.getBytesLength(CALIBRATION_KEY);
+    if (length % sizeof(CalibrationPoint) != 0 || length > sizeof(points))
+        length = 0;
+
+    count = preferences.getBytes(CALIBRATION_KEY, points, length) / sizeof(CalibrationPoint);
+    preferences.end();
+
+    return count > 0;
+}
+
+void CalibrationMap::save()
+{
+    Preferences preferences;
+    if (!preferences.begin(name, false))
+        return;
+
+    if (count == 0)
+        preferences.remove(CALIBRATION_KEY);
+    else
+        preferences.putBytes(CALIBRATION_KEY, points, count * sizeof(CalibrationPoint));
+    preferences.end();
+}
+
+void CalibrationMap::removePoint(uint16_t index)
+{
+    for (uint16_t i = index; i + 1 < count; i++)
+        points[i] = points[i + 1];
+    count--;
+}
+
+void CalibrationMap::record(uint32_t frequency, const int32_t values[CALIBRATION_VALUES], int reflection)
+{
+    // The mechanics drift, so older points close to the new one are replaced
+    for (int i = count - 1; i >= 0; i--)
+    {
+        uint32_t distance = (points[i].frequency > frequency) ? points[i].frequency - frequency : frequency - points[i].frequency;
+        if (distance < CALIBRATION_MERGE_DISTANCE)
+            removePoint(i);
+    }
+
+    // The interior point that is predicted best by its neighbours carries the least information
+    if (count == CALIBRATION_MAP_SIZE)
+    {
+        uint16_t drop_index = 1;
+        float smallest_error = INFINITY;
+        for (uint16_t i = 1; i + 1 < count; i++)
+        {
+            float fraction = (float)(points[i].frequency - points[i - 1].frequency) / (points[i + 1].frequency - points[i - 1].frequency);
+            float error = 0;
+            for (int j = 0; j < CALIBRATION_VALUES; j++)
+                error += fabs(points[i - 1].values[j] + fraction * (points[i + 1].values[j] - points[i - 1].values[j]) - points[i].values[j]);
+
+            if (error < smallest_error)
+            {
+                smallest_error = error;
+                drop_index = i;
+            }
+        }
+        removePoint(drop_index);
+    }
+
+    uint16_t index = count;
+    while (index > 0 && points[index - 1].frequency > frequency)
+    {
+        points[index] = points[index - 1];
+        index--;
+    }
+
+    points[index].frequency = frequency;
+    for (int j = 0; j < CALIBRATION_VALUES; j++)
+        points[index].values[j] = values[j];
+    points[index].reflection = reflection;
+    count++;
+
+    save();
+}
+
+uint32_t CalibrationMap::lookup(uint32_t frequency, int32_t values[CALIBRATION_VALUES], int *reflection)
+{
+    if (count == 0)
+        return UINT32_MAX;
+
+    // First point above the frequency
+    uint16_t upper = 0;
+    while (upper < count && points[upper].frequency < frequency)
+        upper++;
+
+    if (upper == 0 || upper == count)
+    {
+        const CalibrationPoint &closest = points[upper == 0 ? 0 : count - 1];
+        for (int j = 0; j < CALIBRATION_VALUES; j++)
+            values[j] = closest.values[j];
+        if (reflection != nullptr)
+            *reflection = closest.reflection;
+        return (closest.frequency > frequency) ? closest.frequency - frequency : frequency - closest.frequency;
+    }
+
+    const CalibrationPoint &below = points[upper - 1];
+    const CalibrationPoint &above = points[upper];
+    float fraction = (float)(frequency - below.frequency) / (above.frequency - below.frequency);
+    for (int j = 0; j < CALIBRATION_VALUES; j++)
+        values[j] = lround(below.values[j] + fraction * (above.values[j] - below.values[j]));
+    if (reflection != nullptr)
+        *reflection = lround(below.reflection + fraction * (above.reflection - below.reflection));
+
+    return min(frequency - below.frequency, above.frequency - frequency);
+}
+
+void CalibrationMap::clear()
+{
+    count = 0;
+    save();
+}
+
+// Writes the lowest bytes of the value in little endian and advances the data pointer
+static void writeField(uint8_t *&data, int32_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        *data++ = (value >> (8 * i)) & 0xFF;
+}
+
+// Reads a little endian value of the given length and advances the data pointer, the value is sign extended
+static int32_t readField(const uint8_t *&data, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint32_t)*data++ << (8 * i);
+    if (bytes < 4 && (value & (1UL << (8 * bytes - 1))))
+        value |= UINT32_MAX << (8 * bytes);
+    return value;
+}
+
+size_t CalibrationMap::exportData(uint8_t *data)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        writeField(data, points[i].frequency, 4);
+        for (int j = 0; j < CALIBRATION_VALUES; j++)
+            writeField(data, points[i].values[j], 4);
+        writeField(data, points[i].reflection, 2);
+    }
+    return count * CALIBRATION_POINT_BYTES;
+}
+
+boolean CalibrationMap::importData(const uint8_t *data, size_t length)
+{
+    if (length % CALIBRATION_POINT_BYTES != 0 || length / CALIBRATION_POINT_BYTES > CALIBRATION_MAP_SIZE)
+        return false;
+
+    CalibrationPoint imported[CALIBRATION_MAP_SIZE];
+    uint16_t imported_count = length / CALIBRATION_POINT_BYTES;
+    for (uint16_t i = 0; i < imported_count; i++)
+    {
+        imported[i].frequency = readField(data, 4);
+        for (int j = 0; j < CALIBRATION_VALUES; j++)
+            imported[i].values[j] = readField(data, 4);
+        imported[i].reflection = readField(data, 2);
+
+        // lookup() relies on the points being sorted by frequency
+        if (i > 0 && imported[i].frequency <= imported[i - 1].frequency)
+            return false;
+    }
+
+    memcpy(points, imported, imported_count * sizeof(CalibrationPoint));
+    count = imported_count;
+    save();
+
+    return true;
+}
+
+uint16_t CalibrationMap::getCount()
+{
+    return count;
+}
+
+const CalibrationPoint *CalibrationMap::getPoint(uint16_t index)
+{
+    if (index >= count)
+        return nullptr;
+
+    return &points[index];
+}
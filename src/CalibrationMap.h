@@ -0,0 +1,106 @@
+#ifndef CALIBRATIONMAP_H
+#define CALIBRATIONMAP_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+// Maximum number of points that are kept per map
+#define CALIBRATION_MAP_SIZE 64U
+// Points closer than this to a new point are replaced by it
+#define CALIBRATION_MERGE_DISTANCE 200000U // 200kHz
+// Number of values that are stored per frequency, e.g. tuner and matcher position
+#define CALIBRATION_VALUES 2
+// Only results that resonate this close to the target are learned
+#define CALIBRATION_TOLERANCE 500000U // 500kHz
+// Exported size of a point: frequency, values and reflection in little endian without padding
+#define CALIBRATION_POINT_BYTES (4 + 4 * CALIBRATION_VALUES + 2)
+
+struct CalibrationPoint
+{
+    uint32_t frequency;
+    int32_t values[CALIBRATION_VALUES];
+    int16_t reflection; // Reflection in millivolts that was reached with these values
+};
+
+/**
+ * @brief This class learns the settings that tune and match the probe to a frequency.
+ * Every successful tune and match adds a point, for new frequencies the values are interpolated between the neighbouring points.
+ * The points are sorted by frequency and kept in the NVS flash, so they survive a restart.
+ */
+class CalibrationMap
+{
+public:
+    /**
+     * @brief Construct a new Calibration Map
+     *
+     * @param name The NVS namespace of the map, at most 15 characters
+     */
+    CalibrationMap(const char *name);
+
+    /**
+     * @brief This function loads the stored points from the flash. It has to be called once in setup().
+     *
+     * @return boolean True if points were loaded
+     */
+    boolean begin();
+
+    /**
+     * @brief This function adds a point to the map and writes the map to the flash.
+     * Points within CALIBRATION_MERGE_DISTANCE of the new frequency are replaced. If the map is full the point that carries the least information is dropped.
+     *
+     * @param frequency The frequency in Hz
+     * @param values The CALIBRATION_VALUES values that belong to the frequency
+     * @param reflection The reflection in millivolts that was reached
+     */
+    void record(uint32_t frequency, const int32_t values[CALIBRATION_VALUES], int reflection);
+
+    /**
+     * @brief This function interpolates the values for a frequency linearly between the neighbouring points.
+     * Outside of the learned range the values of the closest point are used.
+     *
+     * @param frequency The frequency in Hz
+     * @param values The interpolated values are written here
+     * @param reflection If given, the interpolated reflection that was reached with the values is written here
+     * @return uint32_t The distance in Hz to the closest learned point, UINT32_MAX if the map is empty
+     *
+     * @example
+     * int32_t positions[CALIBRATION_VALUES];
+     * if (positionMap.lookup(83560000U, positions) < 5000000U)
+     *    // positions[0] and positions[1] are a good starting point
+     */
+    uint32_t lookup(uint32_t frequency, int32_t values[CALIBRATION_VALUES], int *reflection = nullptr);
+
+    /**
+     * @brief This function removes all points from the map and from the flash.
+     */
+    void clear();
+
+    /**
+     * @brief This function writes the points field by field, so the map can be backed up or copied to another device independent of the struct layout.
+     *
+     * @param data The points are written here, it has to hold getCount() * CALIBRATION_POINT_BYTES bytes
+     * @return size_t The length of the data in bytes
+     */
+    size_t exportData(uint8_t *data);
+
+    /**
+     * @brief This function replaces the map with exported data and writes it to the flash.
+     *
+     * @param data The data that was written by exportData()
+     * @param length The length of the data in bytes
+     * @return boolean False if the data does not contain valid points, then the map is unchanged
+     */
+    boolean importData(const uint8_t *data, size_t length);
+
+    uint16_t getCount();
+    const CalibrationPoint *getPoint(uint16_t index);
+
+private:
+    void save();
+    void removePoint(uint16_t index);
+    const char *name;
+    CalibrationPoint points[CALIBRATION_MAP_SIZE];
+    uint16_t count = 0;
+};
+
+#endif
@@ -31,4 +31,9 @@ void CommandManager::printCommandResult(char identifier)
   {
     Serial.println("Unknown command.");
   }
+}
+
+bool CommandManager::hasCommand(char identifier)
+{
+  return commandMap.find(identifier) != commandMap.end();
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ public:
   void registerCommand(char identifier, Command* command);
   void executeCommand(char identifier, String input_line);
   void printCommandResult(char identifier);
+  bool hasCommand(char identifier);
 
 private:
   std::map<char, Command*> commandMap;
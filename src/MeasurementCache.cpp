@@ -0,0 +1,118 @@
+#include "MeasurementCache.h"
+#include "global.h"
+
+void MeasurementCache::beginSession()
+{
+    count = 0;
+    next_index = 0;
+    hits = 0;
+    misses = 0;
+    active = true;
+}
+
+String MeasurementCache::endSession()
+{
+    active = false;
+    count = 0;
+    return String(hits) + " of " + String(hits + misses) + " readings reused";
+}
+
+boolean MeasurementCache::isActive()
+{
+    return active;
+}
+
+CachedReading *MeasurementCache::find(uint32_t frequency, uint32_t filter)
+{
+    long tuning_position = tuner.STEPPER.currentPosition();
+    long matching_position = matcher.STEPPER.currentPosition();
+    int8_t tuning_direction = motion.approachDirection(tuner);
+    int8_t matching_direction = motion.approachDirection(matcher);
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        CachedReading &reading = readings[i];
+        if (reading.frequency == frequency && reading.tuning_position == tuning_position && reading.matching_position == matching_position && reading.filter == filter &&
+            reading.tuning_direction == tuning_direction && reading.matching_direction == matching_direction)
+            return &reading;
+    }
+    return nullptr;
+}
+
+CachedReading *MeasurementCache::findOrAdd(uint32_t frequency, uint32_t filter)
+{
+    CachedReading *reading = find(frequency, filter);
+    if (reading != nullptr)
+        return reading;
+
+    reading = &readings[next_index];
+    next_index = (next_index + 1) % MEASUREMENT_CACHE_SIZE;
+    count = min((uint16_t)(count + 1), (uint16_t)MEASUREMENT_CACHE_SIZE);
+
+    *reading = {tuner.STEPPER.currentPosition(), matcher.STEPPER.currentPosition(), motion.approachDirection(tuner), motion.approachDirection(matcher), frequency, filter, 0, 0, 0, 0, 0, 0};
+    return reading;
+}
+
+boolean MeasurementCache::findReflection(uint32_t frequency, uint32_t filter, int averages, int *reflection)
+{
+    if (!active)
+        return false;
+
+    CachedReading *reading = find(frequency, filter);
+    if (reading == nullptr || reading->reflection_averages < averages || millis() - reading->reflection_time >= MEASUREMENT_CACHE_LIFETIME)
+    {
+        misses++;
+        return false;
+    }
+
+    hits++;
+    *reflection = reading->reflection;
+    return true;
+}
+
+boolean MeasurementCache::findPhase(uint32_t frequency, uint32_t filter, int averages, int *phase)
+{
+    if (!active)
+        return false;
+
+    CachedReading *reading = find(frequency, filter);
+    if (reading == nullptr || reading->phase_averages < averages || millis() - reading->phase_time >= MEASUREMENT_CACHE_LIFETIME)
+    {
+        misses++;
+        return false;
+    }
+
+    hits++;
+    *phase = reading->phase;
+    return true;
+}
+
+void MeasurementCache::storeReflection(uint32_t frequency, uint32_t filter, int averages, int reflection)
+{
+    if (!active)
+        return;
+
+    CachedReading *reading = findOrAdd(frequency, filter);
+    unsigned long now = millis();
+    if (reading->reflection_averages > averages && now - reading->reflection_time < MEASUREMENT_CACHE_LIFETIME)
+        return;
+
+    reading->reflection = reflection;
+    reading->reflection_averages = averages;
+    reading->reflection_time = now;
+}
+
+void MeasurementCache::storePhase(uint32_t frequency, uint32_t filter, int averages, int phase)
+{
+    if (!active)
+        return;
+
+    CachedReading *reading = findOrAdd(frequency, filter);
+    unsigned long now = millis();
+    if (reading->phase_averages > averages && now - reading->phase_time < MEASUREMENT_CACHE_LIFETIME)
+        return;
+
+    reading->phase = phase;
+    reading->phase_averages = averages;
+    reading->phase_time = now;
+}
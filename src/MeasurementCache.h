@@ -0,0 +1,87 @@
+#ifndef MEASUREMENTCACHE_H
+#define MEASUREMENTCACHE_H
+
+#include <Arduino.h>
+
+// Number of readings that are kept, the oldest reading is overwritten first
+#define MEASUREMENT_CACHE_SIZE 512U
+// Readings older than this are measured again, the probe drifts with temperature
+#define MEASUREMENT_CACHE_LIFETIME 30000U // ms
+
+struct CachedReading
+{
+    long tuning_position;
+    long matching_position;
+    int8_t tuning_direction;   // direction of the last tuner move, the backlash makes both sides of a position differ
+    int8_t matching_direction; // direction of the last matcher move
+    uint32_t frequency;
+    uint32_t filter;
+    int16_t reflection;
+    int16_t phase;
+    uint16_t reflection_averages; // 0 if the reflection was not measured
+    uint16_t phase_averages;      // 0 if the phase was not measured
+    unsigned long reflection_time;
+    unsigned long phase_time;
+};
+
+/**
+ * @brief This class remembers the readings of a tuning session, so a search that comes back to a stepper position does not measure the same frequencies again.
+ * A reading is identified by the tuner and matcher position, the direction they were approached from, the frequency and the filter.
+ * A cached reading is only reused if it was averaged at least as often as requested.
+ * Outside of a session nothing is cached, e.g. voltage sweeps change the readings without moving a stepper.
+ */
+class MeasurementCache
+{
+public:
+    /**
+     * @brief This function starts a session with an empty cache.
+     */
+    void beginSession();
+
+    /**
+     * @brief This function ends the session and drops all readings.
+     *
+     * @return String A summary how many readings were reused
+     */
+    String endSession();
+
+    /**
+     * @brief This function looks for a reading at the current positions.
+     *
+     * @param frequency The frequency of the reading
+     * @param filter The cutoff frequency of the active filter
+     * @param averages The number of averages the reading needs at least
+     * @param reflection The cached reflection in millivolts is written here
+     * @return boolean True if a valid reading was found
+     */
+    boolean findReflection(uint32_t frequency, uint32_t filter, int averages, int *reflection);
+    boolean findPhase(uint32_t frequency, uint32_t filter, int averages, int *phase);
+
+    /**
+     * @brief This function stores a reading at the current positions. A valid reading that was averaged more often is kept.
+     *
+     * @param frequency The frequency of the reading
+     * @param filter The cutoff frequency of the active filter
+     * @param averages The number of averages of the reading
+     * @param reflection The reflection in millivolts
+     */
+    void storeReflection(uint32_t frequency, uint32_t filter, int averages, int reflection);
+    void storePhase(uint32_t frequency, uint32_t filter, int averages, int phase);
+
+    /**
+     * @brief This function returns true during a session. Scans only have to be aligned to a common grid then, so their readings can be reused.
+     */
+    boolean isActive();
+
+private:
+    CachedReading *find(uint32_t frequency, uint32_t filter);
+    CachedReading *findOrAdd(uint32_t frequency, uint32_t filter);
+    CachedReading readings[MEASUREMENT_CACHE_SIZE];
+    uint16_t count = 0;
+    uint16_t next_index = 0;
+    boolean active = false;
+    unsigned long hits = 0;
+    unsigned long misses = 0;
+};
+
+#endif
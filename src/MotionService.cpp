@@ -0,0 +1,285 @@
+#include "MotionService.h"
+#include "global.h"
+#include "Debug.h"
+
+boolean MotionService::begin()
+{
+    queue = xQueueCreate(MOTION_QUEUE_LENGTH, sizeof(MotionCommand));
+    if (queue != nullptr)
+    {
+        // The task attaches the timers of the step generators, so their interrupts are handled on its core as well
+        setup_task = xTaskGetCurrentTaskHandle();
+        if (xTaskCreatePinnedToCore(taskFunction, "motion", MOTION_TASK_STACK, this, MOTION_TASK_PRIORITY, &task, MOTION_TASK_CORE) == pdPASS)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            return true;
+        }
+        task = nullptr;
+    }
+
+    // Without the task the steps are handled on the core of the caller
+    attachTimers();
+    return false;
+}
+
+void MotionService::attachTimers()
+{
+    // Without a step generator the moves fall back to AccelStepper::run()
+    if (tuner.GENERATOR != nullptr && !tuner.GENERATOR->attachTimer())
+    {
+        DEBUG_PRINT("Could not start the step generator of the tuner");
+        tuner.GENERATOR = nullptr;
+    }
+    if (matcher.GENERATOR != nullptr && !matcher.GENERATOR->attachTimer())
+    {
+        DEBUG_PRINT("Could not start the step generator of the matcher");
+        matcher.GENERATOR = nullptr;
+    }
+}
+
+int MotionService::axisOf(Stepper &stepper)
+{
+    return (stepper.TYPE == "Matcher") ? 1 : 0;
+}
+
+void MotionService::moveTo(Stepper &stepper, long position)
+{
+    MotionCommand command = {};
+    command.steppers[axisOf(stepper)] = &stepper;
+    command.positions[axisOf(stepper)] = position;
+    submit(command);
+}
+
+void MotionService::moveAtSpeed(Stepper &stepper, long position, float speed)
+{
+    MotionCommand command = {};
+    command.steppers[axisOf(stepper)] = &stepper;
+    command.positions[axisOf(stepper)] = position;
+    command.speed = speed;
+    submit(command);
+}
+
+void MotionService::moveBothTo(long tuning_position, long matching_position)
+{
+    MotionCommand command = {{&tuner, &matcher}, {tuning_position, matching_position}};
+    submit(command);
+}
+
+void MotionService::submit(MotionCommand &command)
+{
+    // Without a step generator or motion task the move is executed right here
+    boolean generators = true;
+    for (int axis = 0; axis < MOTION_AXES; axis++)
+    {
+        if (command.steppers[axis] != nullptr && command.steppers[axis]->GENERATOR == nullptr)
+            generators = false;
+    }
+    if (!generators || task == nullptr)
+    {
+        execute(command, generators);
+        return;
+    }
+
+    command.notify = xTaskGetCurrentTaskHandle();
+    for (int axis = 0; axis < MOTION_AXES; axis++)
+    {
+        if (command.steppers[axis] == nullptr)
+            continue;
+
+        targets[axis] = command.positions[axis];
+        portENTER_CRITICAL(&lock);
+        pending[axis]++;
+        portEXIT_CRITICAL(&lock);
+    }
+
+    xQueueSend(queue, &command, portMAX_DELAY);
+}
+
+void MotionService::execute(MotionCommand &command, boolean generators)
+{
+    long start[MOTION_AXES];
+    for (int axis = 0; axis < MOTION_AXES; axis++)
+    {
+        if (command.steppers[axis] != nullptr)
+            start[axis] = command.steppers[axis]->STEPPER.currentPosition();
+    }
+
+    if (generators)
+    {
+        startMoves(command, start);
+        for (int axis = 0; axis < MOTION_AXES; axis++)
+        {
+            if (command.steppers[axis] == nullptr)
+                continue;
+            while (command.steppers[axis]->GENERATOR->isRunning())
+                scheduler.yield();
+            command.steppers[axis]->STEPPER.setCurrentPosition(command.steppers[axis]->GENERATOR->currentPosition());
+        }
+    }
+    else
+    {
+        for (int axis = 0; axis < MOTION_AXES; axis++)
+        {
+            if (command.steppers[axis] == nullptr)
+                continue;
+            command.steppers[axis]->STEPPER.moveTo(command.positions[axis]);
+            if (command.speed != 0)
+                command.steppers[axis]->STEPPER.setSpeed((command.positions[axis] > start[axis]) ? command.speed : -command.speed);
+        }
+
+        boolean moving = true;
+        while (moving)
+        {
+            moving = false;
+            for (int axis = 0; axis < MOTION_AXES; axis++)
+            {
+                if (command.steppers[axis] == nullptr)
+                    continue;
+                AccelStepper &stepper = command.steppers[axis]->STEPPER;
+                if ((command.speed != 0) ? stepper.runSpeedToPosition() : stepper.run())
+                    moving = true;
+            }
+            scheduler.yield();
+        }
+    }
+
+    for (int axis = 0; axis < MOTION_AXES; axis++)
+    {
+        if (command.steppers[axis] != nullptr)
+            moveFinished(axis, command.steppers[axis]->STEPPER.currentPosition() - start[axis]);
+    }
+}
+
+void MotionService::moveFinished(int axis, long distance)
+{
+    if (distance != 0)
+        directions[axis] = (distance > 0) ? 1 : -1;
+    settleModel.moveFinished(axis, distance);
+}
+
+void MotionService::startMoves(MotionCommand &command, const long start[MOTION_AXES])
+{
+    StepGenerator *generators[MOTION_AXES];
+    long from_positions[MOTION_AXES];
+    long to_positions[MOTION_AXES];
+    int count = 0;
+    for (int axis = 0; axis < MOTION_AXES; axis++)
+    {
+        if (command.steppers[axis] == nullptr)
+            continue;
+
+        generators[count] = command.steppers[axis]->GENERATOR;
+        from_positions[count] = start[axis];
+        to_positions[count] = command.positions[axis];
+        count++;
+    }
+
+    if (command.speed != 0)
+    {
+        for (int i = 0; i < count; i++)
+            generators[i]->startConstantSpeed(from_positions[i], to_positions[i], command.speed);
+    }
+    else
+        StepGenerator::startTogether(generators, from_positions, to_positions, count);
+}
+
+void MotionService::move(Stepper &stepper, long steps)
+{
+    int axis = axisOf(stepper);
+    long position = (pending[axis] == 0) ? stepper.STEPPER.currentPosition() : targets[axis];
+    moveTo(stepper, position + steps);
+}
+
+void MotionService::stop(Stepper &stepper)
+{
+    if (stepper.GENERATOR != nullptr)
+        stepper.GENERATOR->stop();
+}
+
+boolean MotionService::isIdle()
+{
+    return pending[0] == 0 && pending[1] == 0;
+}
+
+int8_t MotionService::approachDirection(Stepper &stepper)
+{
+    return directions[axisOf(stepper)];
+}
+
+void MotionService::waitIdle()
+{
+    while (!isIdle())
+    {
+        // The motion task notifies as soon as a move is finished, the timeout keeps the background tasks running during long moves
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MOTION_WAIT_INTERVAL));
+        scheduler.yield();
+    }
+}
+
+void MotionService::taskFunction(void *parameter)
+{
+    ((MotionService *)parameter)->run();
+}
+
+void MotionService::run()
+{
+    attachTimers();
+    xTaskNotifyGive(setup_task);
+
+    MotionCommand command;
+    while (true)
+    {
+        // Without a running move the task sleeps until the next command arrives
+        boolean moving = running[0] || running[1];
+        if (xQueueReceive(queue, &command, moving ? 1 : portMAX_DELAY) == pdTRUE)
+        {
+            // Moves of the same stepper run one after the other, a move of both steppers waits for both
+            for (int axis = 0; axis < MOTION_AXES; axis++)
+            {
+                while (command.steppers[axis] != nullptr && running[axis])
+                {
+                    vTaskDelay(1);
+                    finishMoves();
+                }
+            }
+
+            // The positions are taken when the move starts, commands may have set them since the last move
+            for (int axis = 0; axis < MOTION_AXES; axis++)
+            {
+                if (command.steppers[axis] != nullptr)
+                    start_positions[axis] = command.steppers[axis]->STEPPER.currentPosition();
+            }
+            startMoves(command, start_positions);
+            for (int axis = 0; axis < MOTION_AXES; axis++)
+            {
+                if (command.steppers[axis] == nullptr)
+                    continue;
+                active[axis] = command;
+                running[axis] = true;
+            }
+        }
+
+        finishMoves();
+    }
+}
+
+void MotionService::finishMoves()
+{
+    for (int axis = 0; axis < MOTION_AXES; axis++)
+    {
+        Stepper *stepper = active[axis].steppers[axis];
+        if (!running[axis] || stepper->GENERATOR->isRunning())
+            continue;
+
+        long position = stepper->GENERATOR->currentPosition();
+        stepper->STEPPER.setCurrentPosition(position);
+        moveFinished(axis, position - start_positions[axis]);
+        running[axis] = false;
+
+        portENTER_CRITICAL(&lock);
+        pending[axis]--;
+        portEXIT_CRITICAL(&lock);
+
+        xTaskNotifyGive(active[axis].notify);
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef MOTIONSERVICE_H
+#define MOTIONSERVICE_H
+
+#include <Arduino.h>
+
+struct Stepper;
+
+// Number of moves that can be queued before moveTo() blocks
+#define MOTION_QUEUE_LENGTH 8
+// loop() runs on core 1, so the motion task gets core 0
+#define MOTION_TASK_CORE 0
+#define MOTION_TASK_PRIORITY 2
+#define MOTION_TASK_STACK 4096
+// The tuner and the matcher
+#define MOTION_AXES 2
+// waitIdle() runs the background tasks of the scheduler at least this often
+#define MOTION_WAIT_INTERVAL 10 // ms
+
+struct MotionCommand
+{
+    Stepper *steppers[MOTION_AXES]; // nullptr for the axes that do not move
+    long positions[MOTION_AXES];
+    float speed;         // constant speed in steps/s without ramps, 0 follows the profile of the step generators
+    TaskHandle_t notify; // task that is notified when the move is finished
+};
+
+/**
+ * @brief This class executes the moves of the tuner and the matcher in a FreeRTOS task on its own core.
+ * Moves are queued and return right away, so a function can start a move, prepare the next measurement and only wait when it needs the position.
+ * Moves of the same stepper run one after the other, moves of the tuner and the matcher run at the same time.
+ * Steppers without a step generator are moved by AccelStepper in the calling task and block like before.
+ */
+class MotionService
+{
+public:
+    /**
+     * @brief This function creates the queue and the motion task and attaches the timers of the step generators. It has to be called once in setup(), after StepGenerator::begin().
+     * The timer interrupts are allocated by the motion task, so the steps are handled on its core and not on the one that measures.
+     * A stepper whose timer is not available gets no step generator.
+     *
+     * @return boolean False if the task could not be created, then every move blocks until it is finished
+     */
+    boolean begin();
+
+    /**
+     * @brief This function queues a move to an absolute position.
+     * The position of the AccelStepper of the stepper is updated when the move is finished, the stepper has to stay valid until then.
+     *
+     * @param stepper The stepper that should be moved
+     * @param position The absolute target position
+     *
+     * @example motion.moveTo(tuner, 12000); setFrequency(83000000U); motion.waitIdle(); // programs the synthesizer while the tuner moves
+     */
+    void moveTo(Stepper &stepper, long position);
+
+    /**
+     * @brief This function queues a move at a constant speed without ramps, e.g. for measurements while the stepper moves.
+     *
+     * @param stepper The stepper that should be moved
+     * @param position The absolute target position
+     * @param speed The speed in steps/s, it has to be low enough to start and stop without ramps
+     */
+    void moveAtSpeed(Stepper &stepper, long position, float speed);
+
+    /**
+     * @brief This function queues a move of the tuner and the matcher that starts and ends together, see StepGenerator::startTogether().
+     * Without step generators both steppers are moved by AccelStepper with their own profiles.
+     *
+     * @param tuning_position The absolute target position of the tuner
+     * @param matching_position The absolute target position of the matcher
+     */
+    void moveBothTo(long tuning_position, long matching_position);
+
+    /**
+     * @brief This function queues a move relative to the target of the last queued move of the stepper.
+     */
+    void move(Stepper &stepper, long steps);
+
+    /**
+     * @brief This function decelerates the running move of the stepper, moves that are queued after it are still executed.
+     */
+    void stop(Stepper &stepper);
+
+    /**
+     * @brief This function blocks until all queued moves are finished. The background tasks of the scheduler keep running while it waits.
+     */
+    void waitIdle();
+
+    boolean isIdle();
+
+    /**
+     * @brief This function returns the direction the stepper approached its current position from, the backlash makes both sides differ.
+     *
+     * @param stepper The stepper
+     * @return int8_t 1 or -1 for the direction of the last move that changed the position, 0 before the first move
+     */
+    int8_t approachDirection(Stepper &stepper);
+
+private:
+    static void taskFunction(void *parameter);
+    void run();
+    void finishMoves();
+    void moveFinished(int axis, long distance);
+    void attachTimers();
+    void submit(MotionCommand &command);
+    void execute(MotionCommand &command, boolean generators);
+    void startMoves(MotionCommand &command, const long start[MOTION_AXES]);
+    int axisOf(Stepper &stepper);
+    QueueHandle_t queue = nullptr;
+    TaskHandle_t task = nullptr;
+    TaskHandle_t setup_task = nullptr;
+
+    // Moves per axis that are queued or running, changed by both tasks
+    volatile uint16_t pending[MOTION_AXES] = {0, 0};
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+    // Target of the last queued move per axis, only used by the calling task
+    long targets[MOTION_AXES];
+
+    // Running move per axis, only used by the motion task
+    MotionCommand active[MOTION_AXES];
+    long start_positions[MOTION_AXES];
+    boolean running[MOTION_AXES] = {false, false};
+
+    // Direction of the last finished move per axis, written by the task that finishes the move
+    volatile int8_t directions[MOTION_AXES] = {0, 0};
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef RESONATORMODEL_H
+#define RESONATORMODEL_H
+
+#include <Arduino.h>
+
+// Result of fitResonatorModel, see Utilities.h
+struct ResonatorModel
+{
+  int32_t frequency;            // resonance frequency in Hz, 0 if no resonance was found
+  float loaded_q;               // loaded quality factor, 0 if the bandwidth is not inside the sweep
+  float reflection_coefficient; // magnitude of the reflection coefficient at resonance
+  float coupling;               // coupling factor of the undercoupled solution, the overcoupled one is 1 / coupling
+  float mismatch;               // |ln coupling|, 0 at critical coupling and about linear in the distance of the matcher from it
+  float residual;               // RMS deviation of the model from the sweep in millivolts
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "Scheduler.h"
+
+void Scheduler::addTask(TaskFunction function, uint32_t interval, boolean background)
+{
+    tasks.push_back({function, interval, millis(), true, background});
+}
+
+void Scheduler::addTimer(TaskFunction function, uint32_t delay, boolean background)
+{
+    tasks.push_back({function, delay, millis(), false, background});
+}
+
+void Scheduler::run()
+{
+    runDueTasks(false);
+}
+
+void Scheduler::yield()
+{
+    runDueTasks(true);
+}
+
+void Scheduler::runDueTasks(boolean background_only)
+{
+    // A background task that yields must not start the background tasks again
+    if (background_only && running_background)
+        return;
+
+    unsigned long now = millis();
+
+    // Tasks are accessed by index since a task can add new tasks while it runs
+    for (int i = 0; i < tasks.size(); i++)
+    {
+        if (tasks[i].function == nullptr)
+            continue;
+
+        if (background_only && !tasks[i].background)
+            continue;
+
+        if (now - tasks[i].last_run < tasks[i].interval)
+            continue;
+
+        tasks[i].last_run = now;
+        TaskFunction function = tasks[i].function;
+        boolean background = tasks[i].background;
+
+        // One shot timers are only marked as finished here, they are removed at the end of run()
+        if (!tasks[i].repeat)
+            tasks[i].function = nullptr;
+
+        running_background = background;
+        function();
+        running_background = false;
+    }
+
+    if (!background_only)
+    {
+        for (int i = tasks.size() - 1; i >= 0; i--)
+        {
+            if (tasks[i].function == nullptr)
+                tasks.erase(tasks.begin() + i);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <vector>
+
+/**
+ * @brief Function that is called by the scheduler. It has to return quickly since all tasks share the same core.
+ */
+typedef void (*TaskFunction)();
+
+struct Task
+{
+    TaskFunction function;
+    uint32_t interval; // in ms, 0 means the task runs on every pass of the scheduler
+    unsigned long last_run;
+    boolean repeat;     // false for one shot timers
+    boolean background; // background tasks also run while a command is executed
+};
+
+/**
+ * @brief This class is a small cooperative scheduler for periodic tasks and one shot timers.
+ *
+ * loop() calls run() which executes every task that is due. Commands still run to completion,
+ * but long running functions call yield() regularly so background tasks (e.g. feeding the watchdog)
+ * keep running with bounded latency while a command is executed.
+ */
+class Scheduler
+{
+public:
+    /**
+     * @brief This function adds a periodic task.
+     *
+     * @param function The function that should be called
+     * @param interval The interval in ms, 0 runs the task on every pass
+     * @param background If true, the task also runs from yield() while a command is executed
+     *
+     * @example scheduler.addTask(feedWatchdog, 1000, true); // feeds the watchdog every second, even during commands
+     */
+    void addTask(TaskFunction function, uint32_t interval, boolean background = false);
+
+    /**
+     * @brief This function adds a one shot timer which calls the function once after the delay has passed.
+     *
+     * @param function The function that should be called
+     * @param delay The delay in ms
+     * @param background If true, the timer can also fire from yield() while a command is executed
+     */
+    void addTimer(TaskFunction function, uint32_t delay, boolean background = false);
+
+    /**
+     * @brief This function runs all tasks that are due. It should be called from loop().
+     */
+    void run();
+
+    /**
+     * @brief This function runs all background tasks that are due. It should be called regularly from functions that block for a long time.
+     */
+    void yield();
+
+private:
+    void runDueTasks(boolean background_only);
+    std::vector<Task> tasks;
+    boolean running_background = false;
+};
+
+#endif
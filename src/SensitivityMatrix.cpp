@@ -0,0 +1,77 @@
+#include "SensitivityMatrix.h"
+
+SensitivityMatrix::SensitivityMatrix()
+{
+    // Until something is learned the matcher turns three steps back per tuner step, like the former fixed compensation.
+    // The shift of the resonance by the matcher starts at zero, so no tuner compensation is made before it is measured.
+    jacobian[0][0] = 1000; // Hz per tuner step
+    jacobian[0][1] = 0;    // Hz per matcher step
+    jacobian[1][0] = 3;    // mV per tuner step
+    jacobian[1][1] = 1;    // mV per matcher step
+    matching_ratio = -jacobian[1][0] / jacobian[1][1];
+}
+
+void SensitivityMatrix::observe(long tuning_position, long matching_position, int32_t resonance_frequency, int reflection)
+{
+    if (last_valid)
+    {
+        float tuning_steps = tuning_position - last_tuning_position;
+        float matching_steps = matching_position - last_matching_position;
+        float squared_length = tuning_steps * tuning_steps + matching_steps * matching_steps;
+
+        // A short move keeps the older measurement as reference, so the changes add up until they can be learned from
+        if (squared_length < SENSITIVITY_MINIMUM_STEPS * SENSITIVITY_MINIMUM_STEPS)
+            return;
+
+        // Broyden update: each row is corrected along the move just enough to explain the observed change
+        float frequency_error = (resonance_frequency - last_resonance_frequency) - (jacobian[0][0] * tuning_steps + jacobian[0][1] * matching_steps);
+        jacobian[0][0] += frequency_error * tuning_steps / squared_length;
+        jacobian[0][1] += frequency_error * matching_steps / squared_length;
+
+        // An error within the noise of the readings would only pull the matcher slope towards zero, so the reflection row is not updated then
+        float reflection_error = (reflection - last_reflection) - (jacobian[1][0] * tuning_steps + jacobian[1][1] * matching_steps);
+        if (reflection != 0 && last_reflection != 0 && fabs(reflection_error) > SENSITIVITY_REFLECTION_NOISE)
+        {
+            jacobian[1][0] += reflection_error * tuning_steps / squared_length;
+            jacobian[1][1] += reflection_error * matching_steps / squared_length;
+
+            // Close to the matching optimum the reflection hardly changes with the matcher and the ratio is mostly noise, the last ratio is kept
+            if (fabs(jacobian[1][1]) >= SENSITIVITY_MINIMUM_SLOPE)
+                matching_ratio = constrain(-jacobian[1][0] / jacobian[1][1], -SENSITIVITY_MAXIMUM_RATIO, SENSITIVITY_MAXIMUM_RATIO);
+        }
+    }
+
+    last_valid = true;
+    last_tuning_position = tuning_position;
+    last_matching_position = matching_position;
+    last_resonance_frequency = resonance_frequency;
+    last_reflection = reflection;
+}
+
+void SensitivityMatrix::forget()
+{
+    last_valid = false;
+}
+
+long SensitivityMatrix::matchingCompensation(long tuning_steps)
+{
+    // Reflection change zero: jacobian[1][0] * tuning_steps + jacobian[1][1] * matching_steps = 0
+    return lround(matching_ratio * tuning_steps);
+}
+
+long SensitivityMatrix::tuningCompensation(long matching_steps)
+{
+    return lround(tuningRatio() * matching_steps);
+}
+
+float SensitivityMatrix::tuningRatio()
+{
+    // Frequency change zero: jacobian[0][0] * tuning_steps + jacobian[0][1] * matching_steps = 0
+    float ratio = (jacobian[0][0] != 0) ? -jacobian[0][1] / jacobian[0][0] : 0;
+    return constrain(ratio, -SENSITIVITY_MAXIMUM_RATIO, SENSITIVITY_MAXIMUM_RATIO);
+}
+
+float SensitivityMatrix::get(int row, int column)
+{
+    return jacobian[row][column];
+}
@@ -0,0 +1,83 @@
+#ifndef SENSITIVITYMATRIX_H
+#define SENSITIVITYMATRIX_H
+
+#include <Arduino.h>
+
+// Moves shorter than this are too noisy to learn from
+#define SENSITIVITY_MINIMUM_STEPS 16
+// Largest matcher / tuner step ratio of a compensating move
+#define SENSITIVITY_MAXIMUM_RATIO 10.0f
+// The matcher compensation is only learned while the reflection changes at least this much per matcher step
+#define SENSITIVITY_MINIMUM_SLOPE 0.1 // mV per step
+// Noise of a reflection reading averaged 16 times, reflection changes the matrix already explains within it are not learned from
+#define SENSITIVITY_REFLECTION_NOISE 3 // mV
+
+/**
+ * @brief This class keeps the local 2x2 sensitivity matrix of the probe: how far the resonance frequency and the reflection at resonance
+ * move per tuner step and per matcher step. It is learned online with Broyden updates from consecutive measurements.
+ * With it a move of one stepper can be compensated by the other one, e.g. the matcher keeps the matching while the tuner shifts the resonance.
+ */
+class SensitivityMatrix
+{
+public:
+    SensitivityMatrix();
+
+    /**
+     * @brief This function reports a measurement. The change to the last reported measurement updates the matrix.
+     *
+     * @param tuning_position The tuner position of the measurement
+     * @param matching_position The matcher position of the measurement
+     * @param resonance_frequency The measured resonance frequency in Hz
+     * @param reflection The reflection at resonance in millivolts, 0 if it was not measured
+     */
+    void observe(long tuning_position, long matching_position, int32_t resonance_frequency, int reflection);
+
+    /**
+     * @brief This function drops the last measurement, e.g. after the resonance was lost, so it is not compared to the next one.
+     */
+    void forget();
+
+    /**
+     * @brief This function returns the matcher steps that keep the reflection at resonance when the tuner moves.
+     *
+     * @param tuning_steps The tuner move
+     * @return long The compensating matcher move
+     *
+     * @example sensitivity.matchingCompensation(160); // returns -480 with the initial matrix
+     */
+    long matchingCompensation(long tuning_steps);
+
+    /**
+     * @brief This function returns the tuner steps that keep the resonance frequency when the matcher moves.
+     *
+     * @param matching_steps The matcher move
+     * @return long The compensating tuner move, 0 as long as the shift of the resonance by the matcher is not known
+     */
+    long tuningCompensation(long matching_steps);
+
+    /**
+     * @brief This function returns the tuner steps per matcher step that keep the resonance frequency, see tuningCompensation.
+     * Like the compensations it is limited to SENSITIVITY_MAXIMUM_RATIO, the resulting positions still have to be limited with limitToTravel().
+     */
+    float tuningRatio();
+
+    /**
+     * @brief This function returns an element of the matrix.
+     *
+     * @param row 0 for the resonance frequency in Hz, 1 for the reflection in millivolts
+     * @param column 0 for the tuner, 1 for the matcher
+     * @return float The change per step
+     */
+    float get(int row, int column);
+
+private:
+    float jacobian[2][2];
+    float matching_ratio; // matcher steps per tuner step that keep the reflection
+    boolean last_valid = false;
+    long last_tuning_position;
+    long last_matching_position;
+    int32_t last_resonance_frequency;
+    int last_reflection;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "SettleModel.h"
+#include "global.h"
+
+int SettleModel::bucketOf(long distance)
+{
+    int bucket = 0;
+    while (distance > 1 && bucket < SETTLE_BUCKETS - 1)
+    {
+        distance >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void SettleModel::moveFinished(int axis, long distance)
+{
+    if (distance == 0)
+        return;
+
+    move_end[axis] = millis();
+    move_distance[axis] = labs(distance);
+    moved[axis] = true;
+}
+
+uint32_t SettleModel::predict(int axis, long distance)
+{
+    int bucket = bucketOf(labs(distance));
+    if (observations[axis][bucket] == 0)
+        return SETTLE_DEFAULT_TIME;
+
+    return min((uint32_t)ceil(settle_times[axis][bucket] * SETTLE_MARGIN), (uint32_t)SETTLE_MAXIMUM_TIME);
+}
+
+void SettleModel::waitUntilSettled()
+{
+    unsigned long now = millis();
+    unsigned long wait = 0;
+    for (int axis = 0; axis < MOTION_AXES; axis++)
+    {
+        if (!moved[axis])
+            continue;
+
+        unsigned long elapsed = now - move_end[axis];
+        unsigned long settle_time = predict(axis, move_distance[axis]);
+        if (elapsed < settle_time)
+            wait = max(wait, settle_time - elapsed);
+        moved[axis] = false;
+    }
+
+    if (wait > 0)
+        delay(wait);
+}
+
+void SettleModel::measureSettling()
+{
+    if (!moved[0] && !moved[1])
+        return;
+
+    // The readings bypass the measurement cache, it would return the same value for the same position
+    unsigned long first_reading = millis();
+    unsigned long stable_since = first_reading;
+    int previous_reflection = adac.read_ADC(MAGNITUDE, SETTLE_AVERAGES) * 1000;
+    int stable_readings = 0;
+    while (stable_readings < SETTLE_STABLE_READINGS - 1 && millis() - first_reading < SETTLE_MAXIMUM_TIME)
+    {
+        delay(SETTLE_POLL_INTERVAL);
+        unsigned long reading_time = millis();
+        int reflection = adac.read_ADC(MAGNITUDE, SETTLE_AVERAGES) * 1000;
+
+        if (abs(reflection - previous_reflection) > SETTLE_TOLERANCE)
+        {
+            stable_readings = 0;
+            stable_since = reading_time;
+        }
+        else
+            stable_readings++;
+        previous_reflection = reflection;
+    }
+
+    for (int axis = 0; axis < MOTION_AXES; axis++)
+    {
+        if (!moved[axis])
+            continue;
+
+        // If the first reading was already stable the shaft may have been still before, then only an upper bound is known
+        learn(axis, move_distance[axis], stable_since - move_end[axis], stable_since == first_reading);
+        moved[axis] = false;
+    }
+}
+
+void SettleModel::settle()
+{
+    for (int axis = 0; axis < MOTION_AXES; axis++)
+    {
+        if (moved[axis] && observations[axis][bucketOf(move_distance[axis])] < SETTLE_LEARNING_OBSERVATIONS)
+        {
+            measureSettling();
+            return;
+        }
+    }
+
+    waitUntilSettled();
+}
+
+void SettleModel::learn(int axis, long distance, float settle_time, boolean upper_bound)
+{
+    int bucket = bucketOf(distance);
+    uint8_t &count = observations[axis][bucket];
+    if (upper_bound && count > 0 && settle_time >= settle_times[axis][bucket])
+        return;
+
+    count = min(count + 1, SETTLE_MAXIMUM_WEIGHT);
+    if (count == 1)
+        settle_times[axis][bucket] = settle_time;
+    else
+        settle_times[axis][bucket] += (settle_time - settle_times[axis][bucket]) / count;
+}
@@ -0,0 +1,78 @@
+#ifndef SETTLEMODEL_H
+#define SETTLEMODEL_H
+
+#include <Arduino.h>
+#include "MotionService.h"
+
+// Moves are grouped by distance in powers of two, the last bucket holds everything from 2^15 steps on
+#define SETTLE_BUCKETS 16
+// Settle time before anything was learned, this was the fixed delay after a move
+#define SETTLE_DEFAULT_TIME 50 // ms
+#define SETTLE_MAXIMUM_TIME 200 // ms
+// The learned times are stretched by this factor when they are used for waiting
+#define SETTLE_MARGIN 1.25
+// While measuring, readings that differ less than SETTLE_TOLERANCE count as still
+#define SETTLE_POLL_INTERVAL 2 // ms
+#define SETTLE_AVERAGES 4
+#define SETTLE_TOLERANCE 4 // mV
+#define SETTLE_STABLE_READINGS 3
+// The settling of a distance bucket is measured until it has this many observations, after that the learned time is waited
+#define SETTLE_LEARNING_OBSERVATIONS 3
+// Weight of the newest observation is at least 1 / SETTLE_MAXIMUM_WEIGHT, so the model follows slow changes of the mechanics
+#define SETTLE_MAXIMUM_WEIGHT 8
+
+/**
+ * @brief This class learns how long the capacitor shafts ring after a move, depending on the stepper and the distance of the move.
+ * Measurements after a move wait for the learned time instead of a fixed delay.
+ * Where the reflection is sensitive to the positions the settling is measured until the model knows the distance, which teaches it.
+ */
+class SettleModel
+{
+public:
+    /**
+     * @brief This function records the end of a move. It is called by the motion service.
+     *
+     * @param axis 0 for the tuner, 1 for the matcher
+     * @param distance The distance of the move in steps
+     */
+    void moveFinished(int axis, long distance);
+
+    /**
+     * @brief This function waits until the steppers that moved since the last call are expected to be still.
+     * Time that passed since the end of the moves, e.g. for a frequency scan, is not waited again.
+     */
+    void waitUntilSettled();
+
+    /**
+     * @brief This function reads the reflection at the current frequency until it is stable and learns the settle time from it.
+     * The frequency should be close to the resonance, otherwise the reflection does not depend on the positions.
+     */
+    void measureSettling();
+
+    /**
+     * @brief This function measures the settling while the distance of a move that just finished has few observations, otherwise it waits the learned time.
+     * The frequency should be close to the resonance like for measureSettling().
+     */
+    void settle();
+
+    /**
+     * @brief This function returns the time in ms a stepper is expected to ring after a move.
+     *
+     * @param axis 0 for the tuner, 1 for the matcher
+     * @param distance The distance of the move in steps
+     */
+    uint32_t predict(int axis, long distance);
+
+private:
+    int bucketOf(long distance);
+    void learn(int axis, long distance, float settle_time, boolean upper_bound);
+    float settle_times[MOTION_AXES][SETTLE_BUCKETS];
+    uint8_t observations[MOTION_AXES][SETTLE_BUCKETS] = {};
+
+    // Last move per axis, written by the motion task
+    volatile unsigned long move_end[MOTION_AXES];
+    volatile long move_distance[MOTION_AXES];
+    volatile boolean moved[MOTION_AXES] = {false, false};
+};
+
+#endif
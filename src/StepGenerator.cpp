@@ -0,0 +1,298 @@
+#include "StepGenerator.h"
+
+// The timer interrupts have no argument, so every timer has its own handler that calls its generator
+static StepGenerator *timer_generators[STEP_GENERATOR_TIMERS];
+
+static void IRAM_ATTR onTimer0() { timer_generators[0]->onTimer(); }
+static void IRAM_ATTR onTimer1() { timer_generators[1]->onTimer(); }
+static void IRAM_ATTR onTimer2() { timer_generators[2]->onTimer(); }
+static void IRAM_ATTR onTimer3() { timer_generators[3]->onTimer(); }
+
+static void (*const TIMER_HANDLERS[STEP_GENERATOR_TIMERS])() = {onTimer0, onTimer1, onTimer2, onTimer3};
+
+StepGenerator::StepGenerator(uint8_t step_pin, uint8_t direction_pin, boolean invert_direction, uint8_t timer_number)
+    : step_pin(step_pin), direction_pin(direction_pin), invert_direction(invert_direction), timer_number(timer_number)
+{
+}
+
+StepProfile StepGenerator::planProfile(float speed, float acceleration, float jerk)
+{
+    StepProfile profile;
+    profile.speed = speed;
+    profile.jerk = jerk;
+    // Slow ramps never reach the maximum acceleration
+    profile.acceleration = min(acceleration, (float)sqrt(speed * jerk));
+    profile.jerk_time = profile.acceleration / jerk;
+    profile.constant_time = speed / profile.acceleration - profile.jerk_time;
+    profile.ramp_time = 2 * profile.jerk_time + profile.constant_time;
+    // The speed rises point symmetrically, so the ramp covers half of what the peak speed would cover in the same time
+    profile.ramp_distance = speed * profile.ramp_time / 2;
+    return profile;
+}
+
+StepProfile StepGenerator::planProfile(float distance, float speed, float acceleration, float jerk)
+{
+    StepProfile profile = planProfile(speed, acceleration, jerk);
+    if (2 * profile.ramp_distance <= distance)
+        return profile;
+
+    // A short move gets a lower peak speed whose ramp ends in the middle of the move, so it accelerates and decelerates with the jerk as well
+    float lower = 0;
+    float upper = speed;
+    for (int i = 0; i < 24; i++)
+    {
+        float middle = (lower + upper) / 2;
+        if (2 * planProfile(middle, acceleration, jerk).ramp_distance < distance)
+            lower = middle;
+        else
+            upper = middle;
+    }
+    return planProfile(upper, acceleration, jerk);
+}
+
+float StepGenerator::rampTime(const StepProfile &profile, float distance)
+{
+    if (distance >= profile.ramp_distance)
+        return profile.ramp_time + (distance - profile.ramp_distance) / profile.speed;
+
+    float jerk_time = profile.jerk_time;
+    float jerk_speed = profile.jerk * jerk_time * jerk_time / 2;
+    float jerk_distance = jerk_speed * jerk_time / 3;
+    if (distance <= jerk_distance)
+        return cbrt(6 * distance / profile.jerk);
+
+    float constant_distance = jerk_speed * profile.constant_time + profile.acceleration * profile.constant_time * profile.constant_time / 2;
+    distance -= jerk_distance;
+    if (distance <= constant_distance)
+        return jerk_time + (sqrt(jerk_speed * jerk_speed + 2 * profile.acceleration * distance) - jerk_speed) / profile.acceleration;
+
+    // The distance is convex in the time while the acceleration falls, so Newton's method converges from the end of the ramp
+    distance -= constant_distance;
+    float speed = jerk_speed + profile.acceleration * profile.constant_time;
+    float t = jerk_time;
+    for (int i = 0; i < 6; i++)
+    {
+        float error = speed * t + profile.acceleration * t * t / 2 - profile.jerk * t * t * t / 6 - distance;
+        t -= error / (speed + profile.acceleration * t - profile.jerk * t * t / 2);
+    }
+    return jerk_time + profile.constant_time + constrain(t, 0.0f, jerk_time);
+}
+
+uint32_t StepGenerator::rampSteps(const StepProfile &profile, float path_length, uint32_t steps)
+{
+    // Every step after the ramp follows at the peak speed, the steps after the middle of the move mirror the ones before it
+    float step_length = path_length / steps;
+    uint32_t accelerating_steps = ceil(profile.ramp_distance / step_length) + 1;
+    return min(accelerating_steps, (steps + 1) / 2);
+}
+
+boolean StepGenerator::begin(float max_speed, float acceleration, float jerk)
+{
+    if (timer_number >= STEP_GENERATOR_TIMERS)
+        return false;
+
+    this->max_speed = max_speed;
+    max_acceleration = acceleration;
+    max_jerk = jerk;
+
+    // Moves of this stepper alone need the longest ramp, startTogether() keeps the ramps of shared moves within it
+    ramp_capacity = ceil(planProfile(max_speed, acceleration, jerk).ramp_distance) + 1;
+    ramp = (uint32_t *)malloc(ramp_capacity * sizeof(uint32_t));
+    if (ramp == nullptr)
+        return false;
+
+    pinMode(step_pin, OUTPUT);
+    pinMode(direction_pin, OUTPUT);
+
+    return true;
+}
+
+boolean StepGenerator::attachTimer()
+{
+    if (ramp == nullptr)
+        return false;
+
+    timer_generators[timer_number] = this;
+    timer = timerBegin(timer_number, STEP_TIMER_DIVIDER, true);
+    if (timer == nullptr)
+        return false;
+    timerAttachInterrupt(timer, TIMER_HANDLERS[timer_number], true);
+
+    return true;
+}
+
+void StepGenerator::start(long from_position, long to_position)
+{
+    StepGenerator *generator = this;
+    startTogether(&generator, &from_position, &to_position, 1);
+}
+
+void StepGenerator::startTogether(StepGenerator *const generators[], const long from_positions[], const long to_positions[], int count)
+{
+    // The profile is planned along the distance of the longest move, the other steppers take their steps at the same fractions of it
+    float path_length = 0;
+    for (int i = 0; i < count; i++)
+        path_length = max(path_length, (float)labs(to_positions[i] - from_positions[i]));
+
+    StepProfile profile = {};
+    if (path_length > 0)
+    {
+        // Scaled to the path a shorter move has proportionally higher limits, the profile has to respect the lowest one
+        float speed = INFINITY;
+        float acceleration = INFINITY;
+        float jerk = INFINITY;
+        for (int i = 0; i < count; i++)
+        {
+            long steps = labs(to_positions[i] - from_positions[i]);
+            if (steps == 0)
+                continue;
+            float scale = path_length / steps;
+            speed = min(speed, generators[i]->max_speed * scale);
+            acceleration = min(acceleration, generators[i]->max_acceleration * scale);
+            jerk = min(jerk, generators[i]->max_jerk * scale);
+        }
+        profile = planProfile(path_length, speed, acceleration, jerk);
+
+        // A lower speed shortens the ramps until they fit into the tables of all steppers
+        boolean fits = false;
+        while (!fits)
+        {
+            fits = true;
+            for (int i = 0; i < count; i++)
+            {
+                long steps = labs(to_positions[i] - from_positions[i]);
+                if (steps > 0 && generators[i]->rampSteps(profile, path_length, steps) > generators[i]->ramp_capacity)
+                    fits = false;
+            }
+            if (!fits)
+                profile = planProfile(path_length, profile.speed * 0.8, acceleration, jerk);
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+        generators[i]->prepareMove(from_positions[i], to_positions[i], profile, path_length);
+
+    // The timers are started last so the steppers start as close together as possible
+    for (int i = 0; i < count; i++)
+    {
+        if (generators[i]->running)
+            generators[i]->startTimer(generators[i]->ramp[0]);
+    }
+}
+
+void StepGenerator::prepareMove(long from_position, long to_position, const StepProfile &profile, float path_length)
+{
+    timerAlarmDisable(timer);
+
+    position = from_position;
+    direction = (to_position >= from_position) ? 1 : -1;
+    steps_done = 0;
+    steps_total = labs(to_position - from_position);
+    constant_interval = 0;
+    running = steps_total > 0;
+    if (!running)
+        return;
+
+    // The second half of the move mirrors the first one. The step times are rounded as a whole, so the rounding errors of the intervals do not add up
+    float step_length = path_length / steps_total;
+    float half_time = rampTime(profile, path_length / 2);
+    ramp_steps = rampSteps(profile, path_length, steps_total);
+    uint32_t previous_tick = 0;
+    for (uint32_t i = 0; i < ramp_steps; i++)
+    {
+        float distance = (i + 1) * step_length;
+        float time = (distance <= path_length / 2) ? rampTime(profile, distance) : 2 * half_time - rampTime(profile, path_length - distance);
+        uint32_t tick = lround(time * STEP_TIMER_FREQUENCY);
+        ramp[i] = max(tick - previous_tick, (uint32_t)1);
+        previous_tick = tick;
+    }
+    cruise_interval = min(step_length / profile.speed * STEP_TIMER_FREQUENCY * 256, (float)INT32_MAX);
+    cruise_fraction = 0;
+
+    digitalWrite(direction_pin, ((direction > 0) != invert_direction) ? HIGH : LOW);
+}
+
+void StepGenerator::startTimer(uint32_t first_interval)
+{
+    // From the first step on the interrupt schedules the steps
+    timerWrite(timer, 0);
+    timerAlarmWrite(timer, max(first_interval, (uint32_t)STEP_DIRECTION_SETUP), true);
+    timerAlarmEnable(timer);
+}
+
+void StepGenerator::startConstantSpeed(long from_position, long to_position, float speed)
+{
+    timerAlarmDisable(timer);
+
+    position = from_position;
+    direction = (to_position >= from_position) ? 1 : -1;
+    steps_done = 0;
+    steps_total = labs(to_position - from_position);
+    constant_interval = max(lround(STEP_TIMER_FREQUENCY / fabs(speed)), 1L);
+    running = steps_total > 0;
+    if (!running)
+        return;
+
+    digitalWrite(direction_pin, ((direction > 0) != invert_direction) ? HIGH : LOW);
+
+    // The first step follows right away
+    startTimer(STEP_DIRECTION_SETUP);
+}
+
+void StepGenerator::stop()
+{
+    portENTER_CRITICAL(&lock);
+    // Decelerating takes as many steps as accelerating to the current speed
+    uint32_t stopping_steps = (constant_interval != 0) ? 0 : min((uint32_t)steps_done, ramp_steps);
+    if (steps_done + stopping_steps < steps_total)
+        steps_total = steps_done + stopping_steps;
+    portEXIT_CRITICAL(&lock);
+}
+
+boolean StepGenerator::isRunning()
+{
+    return running;
+}
+
+long StepGenerator::currentPosition()
+{
+    return position;
+}
+
+void IRAM_ATTR StepGenerator::onTimer()
+{
+    portENTER_CRITICAL_ISR(&lock);
+    if (steps_done < steps_total)
+    {
+        digitalWrite(step_pin, HIGH);
+        position += direction;
+        steps_done++;
+        delayMicroseconds(STEP_PULSE_WIDTH);
+        digitalWrite(step_pin, LOW);
+    }
+
+    if (steps_done >= steps_total)
+    {
+        timerAlarmDisable(timer);
+        running = false;
+        portEXIT_CRITICAL_ISR(&lock);
+        return;
+    }
+
+    uint32_t interval = constant_interval;
+    if (interval == 0)
+    {
+        // Accelerate along the ramp, cruise at the peak speed and decelerate along the ramp backwards
+        uint32_t index = min(steps_done + 1, steps_total - steps_done);
+        if (index <= ramp_steps)
+            interval = ramp[index - 1];
+        else
+        {
+            cruise_fraction += cruise_interval;
+            interval = cruise_fraction >> 8;
+            cruise_fraction &= 0xFF;
+        }
+    }
+    timerAlarmWrite(timer, interval, true);
+    portEXIT_CRITICAL_ISR(&lock);
+}
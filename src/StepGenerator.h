@@ -0,0 +1,154 @@
+#ifndef STEPGENERATOR_H
+#define STEPGENERATOR_H
+
+#include <Arduino.h>
+
+// The hardware timers count with the 80MHz APB clock divided by this, one tick is 0.25us
+// so the intervals near maximum speed are resolved finely enough for a smooth end of the ramp
+#define STEP_TIMER_DIVIDER 20
+#define STEP_TIMER_FREQUENCY 4000000U
+// The ESP32 has four hardware timers
+#define STEP_GENERATOR_TIMERS 4
+// Ticks between setting the direction pin and the first step pulse
+#define STEP_DIRECTION_SETUP 2
+// High time of a step pulse, like AccelStepper. The TMC2130 needs at least 100ns
+#define STEP_PULSE_WIDTH 1 // us
+
+/**
+ * @brief Speed profile of a move. The acceleration rises with the jerk to its peak, stays there for constant_time
+ * and falls back to zero when the peak speed is reached, the deceleration mirrors it.
+ */
+struct StepProfile
+{
+    float speed;         // peak speed in steps/s
+    float acceleration;  // peak acceleration in steps/s^2
+    float jerk;          // in steps/s^3
+    float jerk_time;     // duration of the rise and of the fall of the acceleration in s
+    float constant_time; // duration of the constant acceleration in s
+    float ramp_time;     // duration of the acceleration in s
+    float ramp_distance; // steps until the peak speed is reached
+};
+
+/**
+ * @brief This class generates the step pulses of a stepper with a hardware timer instead of polling AccelStepper::run().
+ * The intervals of the steps that accelerate and decelerate are computed when a move starts, the timer interrupt only looks them up,
+ * so the timing does not depend on what the main loop does and the CPU is free for measurements during a move.
+ * AccelStepper still keeps the position of the stepper, the generator only executes moves between two positions.
+ */
+class StepGenerator
+{
+public:
+    /**
+     * @brief Construct a new Step Generator
+     *
+     * @param step_pin The step pin of the driver
+     * @param direction_pin The direction pin of the driver
+     * @param invert_direction True if the direction pin is low for positive steps, like setPinsInverted() of AccelStepper
+     * @param timer_number The hardware timer that is used, 0 to STEP_GENERATOR_TIMERS - 1
+     */
+    StepGenerator(uint8_t step_pin, uint8_t direction_pin, boolean invert_direction, uint8_t timer_number);
+
+    /**
+     * @brief This function allocates the ramp for the limits of the stepper. It has to be called once in setup().
+     * The acceleration builds up and decays with the jerk, so the capacitor shafts are not kicked at the start and at the end of a move.
+     *
+     * @param max_speed The maximum speed in steps/s
+     * @param acceleration The maximum acceleration in steps/s^2
+     * @param jerk The jerk in steps/s^3
+     * @return boolean False if the ramp could not be allocated or the timer number is not valid
+     */
+    boolean begin(float max_speed, float acceleration, float jerk);
+
+    /**
+     * @brief This function sets up the timer and its interrupt. It has to be called once after begin() on the core that should handle the steps,
+     * the ESP32 allocates an interrupt on the core that attaches it.
+     *
+     * @return boolean False if the timer is not available
+     */
+    boolean attachTimer();
+
+    /**
+     * @brief This function starts a move with an S-curve speed profile and returns right away.
+     * Moves that are too short to reach the maximum speed are planned with a lower peak speed, so they are jerk limited as well.
+     *
+     * @param from_position The current position of the stepper
+     * @param to_position The target position of the stepper
+     *
+     * @example tuning_generator.start(1000, 5000); while (tuning_generator.isRunning()) scheduler.yield();
+     */
+    void start(long from_position, long to_position);
+
+    /**
+     * @brief This function starts moves of several steppers that follow one common profile, so they start and end together
+     * and every stepper is at the same fraction of its distance at any time. The profile respects the limits of every stepper.
+     *
+     * @param generators The generators of the steppers
+     * @param from_positions The current positions of the steppers
+     * @param to_positions The target positions of the steppers
+     * @param count The number of steppers
+     *
+     * @example StepGenerator *both[] = {&tuning_generator, &matching_generator}; StepGenerator::startTogether(both, from, to, 2);
+     */
+    static void startTogether(StepGenerator *const generators[], const long from_positions[], const long to_positions[], int count);
+
+    /**
+     * @brief This function starts a move at a constant speed without ramps, e.g. for measurements while the stepper moves.
+     *
+     * @param from_position The current position of the stepper
+     * @param to_position The target position of the stepper
+     * @param speed The speed in steps/s, it has to be low enough to start and stop without ramps
+     */
+    void startConstantSpeed(long from_position, long to_position, float speed);
+
+    /**
+     * @brief This function decelerates the running move along the ramp and stops it as soon as possible.
+     */
+    void stop();
+
+    boolean isRunning();
+
+    /**
+     * @brief This function returns the position of the stepper, it is updated with every step of a running move.
+     */
+    long currentPosition();
+
+    /**
+     * @brief This function issues one step and schedules the next one. It is only called from the timer interrupt.
+     */
+    void onTimer();
+
+private:
+    static StepProfile planProfile(float speed, float acceleration, float jerk);
+    static StepProfile planProfile(float distance, float speed, float acceleration, float jerk);
+    static float rampTime(const StepProfile &profile, float distance);
+    uint32_t rampSteps(const StepProfile &profile, float path_length, uint32_t steps);
+    void prepareMove(long from_position, long to_position, const StepProfile &profile, float path_length);
+    void startTimer(uint32_t first_interval);
+    uint8_t step_pin;
+    uint8_t direction_pin;
+    boolean invert_direction;
+    uint8_t timer_number;
+    hw_timer_t *timer = nullptr;
+
+    float max_speed;
+    float max_acceleration;
+    float max_jerk;
+
+    // Intervals in timer ticks between the steps of the running move that accelerate, the deceleration uses them backwards
+    uint32_t *ramp = nullptr;
+    uint32_t ramp_capacity = 0;
+
+    // State of the running move, shared with the timer interrupt
+    volatile int32_t position = 0;
+    volatile int8_t direction = 1;
+    volatile uint32_t steps_done = 0;
+    volatile uint32_t steps_total = 0;
+    volatile boolean running = false;
+    uint32_t ramp_steps = 0;
+    uint32_t cruise_interval = 0;   // in 1/256 timer ticks, the interrupt must not use the FPU
+    uint32_t cruise_fraction = 0;   // fraction of a tick that is carried to the next cruise interval
+    uint32_t constant_interval = 0; // in timer ticks, 0 follows the ramp
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
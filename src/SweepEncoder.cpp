@@ -0,0 +1,47 @@
+#include "Utilities.h"
+#include "SweepEncoder.h"
+
+void SweepEncoder::begin(uint32_t start_frequency, uint32_t frequency_step, uint32_t count, int averages)
+{
+    last_reflection = 0;
+    last_phase = 0;
+
+    String header = "x" + String(start_frequency) + "," + String(frequency_step) + "," + String(count) + "," + String(averages);
+
+    // List every point where the filterbank switches so the PC knows which filter was used for which point
+    uint32_t filter_fg = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Filter filter = getFilter(start_frequency + i * frequency_step);
+        if (filter.fg != filter_fg)
+        {
+            filter_fg = filter.fg;
+            header += "s" + String(i) + "," + String(filter_fg);
+        }
+    }
+
+    Serial.println(header);
+}
+
+void SweepEncoder::addPoint(int reflection, int phase)
+{
+    writeDelta(reflection - last_reflection);
+    writeDelta(phase - last_phase);
+
+    last_reflection = reflection;
+    last_phase = phase;
+}
+
+void SweepEncoder::writeDelta(int32_t delta)
+{
+    // Zigzag encoding maps small negative and positive deltas to small unsigned values
+    uint32_t value = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+
+    // Every byte carries 7 bits, the highest bit tells if another byte follows
+    while (value >= 0x80)
+    {
+        Serial.write((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    Serial.write((uint8_t)value);
+}
@@ -0,0 +1,48 @@
+#ifndef SWEEPENCODER_H
+#define SWEEPENCODER_H
+
+#include <Arduino.h>
+
+/**
+ * @brief This class sends frequency sweep data in a compact delta encoded format instead of one text line per point.
+ *
+ * The sweep starts with a text header line:
+ * x<start frequency>,<frequency step>,<number of points>,<averages>s<point index>,<filter fg>s<point index>,<filter fg>...
+ * There is one s entry for every filter that is used, starting at point index 0.
+ *
+ * The header is followed by exactly two varints per point, first the reflection then the phase.
+ * Every value is the difference to the previous value of the same kind (the first one to 0) in millivolts,
+ * zigzag encoded and written as little endian base 128 varint. No newline follows the binary data.
+ * Millivolts are used instead of raw 12 bit ADC codes because averaged readings are not whole codes and the readings
+ * are only available in millivolts from readReflection() and readPhase(), which also serve them from the measurement cache.
+ * With the ADC range of twice the 2.5 V reference one code is about 1.2 mV, so the deltas need practically the same varint length and the values match the text format.
+ * A reference decoder for the PC can be found in tools/sweep_decoder.py.
+ */
+class SweepEncoder
+{
+public:
+    /**
+     * @brief This function sends the header line and resets the delta encoding.
+     *
+     * @param start_frequency The first frequency of the sweep
+     * @param frequency_step The frequency step size
+     * @param count The number of points that will follow
+     * @param averages The number of averages per reflection point
+     */
+    void begin(uint32_t start_frequency, uint32_t frequency_step, uint32_t count, int averages);
+
+    /**
+     * @brief This function sends one point of the sweep.
+     *
+     * @param reflection The reflection in millivolts
+     * @param phase The phase in millivolts
+     */
+    void addPoint(int reflection, int phase);
+
+private:
+    void writeDelta(int32_t delta);
+    int last_reflection;
+    int last_phase;
+};
+
+#endif
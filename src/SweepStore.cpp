@@ -0,0 +1,107 @@
+#include "SweepStore.h"
+
+boolean SweepStore::begin()
+{
+    size_t buffer_size;
+
+    // With PSRAM many more sweeps can be kept
+    if (psramFound())
+    {
+        slots = SWEEP_SLOTS_PSRAM;
+        buffer_size = slots * MAX_SWEEP_POINTS * sizeof(uint16_t);
+        reflections = (uint16_t *)ps_malloc(buffer_size);
+        phases = (uint16_t *)ps_malloc(buffer_size);
+    }
+    else
+    {
+        slots = SWEEP_SLOTS;
+        buffer_size = slots * MAX_SWEEP_POINTS * sizeof(uint16_t);
+        reflections = (uint16_t *)malloc(buffer_size);
+        phases = (uint16_t *)malloc(buffer_size);
+    }
+    headers = (SweepHeader *)malloc(slots * sizeof(SweepHeader));
+
+    if (reflections == nullptr || phases == nullptr || headers == nullptr)
+    {
+        slots = 0;
+        return false;
+    }
+
+    for (int i = 0; i < slots; i++)
+        headers[i].id = -1;
+
+    // The first sweep goes to slot 0
+    current_slot = slots - 1;
+
+    return true;
+}
+
+int32_t SweepStore::startSweep(uint32_t start_frequency, uint32_t frequency_step, int averages)
+{
+    if (slots == 0)
+        return -1;
+
+    current_slot = (current_slot + 1) % slots;
+    headers[current_slot] = {next_id, start_frequency, frequency_step, 0, (uint16_t)averages};
+
+    return next_id++;
+}
+
+void SweepStore::addPoint(int reflection, int phase)
+{
+    if (slots == 0)
+        return;
+
+    SweepHeader &header = headers[current_slot];
+    if (header.count >= MAX_SWEEP_POINTS)
+        return;
+
+    reflections[current_slot * MAX_SWEEP_POINTS + header.count] = reflection;
+    phases[current_slot * MAX_SWEEP_POINTS + header.count] = phase;
+    header.count++;
+}
+
+int SweepStore::findSlot(int32_t id)
+{
+    for (int i = 0; i < slots; i++)
+    {
+        if (headers[i].id == id)
+            return i;
+    }
+    return -1;
+}
+
+const SweepHeader *SweepStore::getHeader(int32_t id)
+{
+    int slot = findSlot(id);
+    if (id < 0 || slot == -1)
+        return nullptr;
+
+    return &headers[slot];
+}
+
+const SweepHeader *SweepStore::getSlotHeader(uint16_t slot)
+{
+    return &headers[slot];
+}
+
+uint16_t SweepStore::getSlots()
+{
+    return slots;
+}
+
+uint32_t SweepStore::getFrequency(int32_t id, uint16_t index)
+{
+    const SweepHeader *header = getHeader(id);
+    return header->start_frequency + index * header->frequency_step;
+}
+
+uint16_t SweepStore::getReflection(int32_t id, uint16_t index)
+{
+    return reflections[findSlot(id) * MAX_SWEEP_POINTS + index];
+}
+
+uint16_t SweepStore::getPhase(int32_t id, uint16_t index)
+{
+    return phases[findSlot(id) * MAX_SWEEP_POINTS + index];
+}
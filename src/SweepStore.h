@@ -0,0 +1,85 @@
+#ifndef SWEEPSTORE_H
+#define SWEEPSTORE_H
+
+#include <Arduino.h>
+
+// Maximum number of points that are stored per sweep
+#define MAX_SWEEP_POINTS 2048U
+// Number of sweeps that are kept, the oldest sweep is overwritten first
+#define SWEEP_SLOTS 4U
+#define SWEEP_SLOTS_PSRAM 128U
+
+struct SweepHeader
+{
+    int32_t id; // -1 for unused slots
+    uint32_t start_frequency;
+    uint32_t frequency_step;
+    uint16_t count;
+    uint16_t averages;
+};
+
+/**
+ * @brief This class keeps the results of the last frequency sweeps so they can be fetched again without re-measuring.
+ * The reflection and phase of a sweep are stored as separate uint16 arrays in millivolts, the frequencies follow from the header.
+ * The buffer is allocated in PSRAM if the board has one, then more sweeps are kept.
+ */
+class SweepStore
+{
+public:
+    /**
+     * @brief This function allocates the buffer. It has to be called once in setup().
+     *
+     * @return boolean True if the buffer could be allocated
+     */
+    boolean begin();
+
+    /**
+     * @brief This function starts a new sweep and overwrites the oldest stored sweep.
+     *
+     * @param start_frequency The first frequency of the sweep
+     * @param frequency_step The frequency step size
+     * @param averages The number of averages per reflection point
+     * @return int32_t The id of the new sweep, -1 if there is no buffer
+     */
+    int32_t startSweep(uint32_t start_frequency, uint32_t frequency_step, int averages);
+
+    /**
+     * @brief This function adds a point to the sweep that was started last. Points beyond MAX_SWEEP_POINTS are dropped.
+     *
+     * @param reflection The reflection in millivolts
+     * @param phase The phase in millivolts
+     */
+    void addPoint(int reflection, int phase);
+
+    /**
+     * @brief This function returns the header of a stored sweep.
+     *
+     * @param id The id of the sweep
+     * @return const SweepHeader* The header or nullptr if the sweep is not stored (anymore)
+     */
+    const SweepHeader *getHeader(int32_t id);
+
+    /**
+     * @brief This function returns the header of the n-th slot, used to list all stored sweeps.
+     *
+     * @param slot The slot index from 0 to getSlots() - 1
+     * @return const SweepHeader* The header, its id is -1 if the slot is unused
+     */
+    const SweepHeader *getSlotHeader(uint16_t slot);
+    uint16_t getSlots();
+
+    uint32_t getFrequency(int32_t id, uint16_t index);
+    uint16_t getReflection(int32_t id, uint16_t index);
+    uint16_t getPhase(int32_t id, uint16_t index);
+
+private:
+    int findSlot(int32_t id);
+    SweepHeader *headers = nullptr;
+    uint16_t *reflections = nullptr;
+    uint16_t *phases = nullptr;
+    uint16_t slots = 0;
+    uint16_t current_slot = 0;
+    int32_t next_id = 0;
+};
+
+#endif
@@ -1,22 +1,52 @@
 #include <TMC2130Stepper.h>
 #include <AccelStepper.h>
 #include <MultiStepper.h>
+#include <utility>
+#include <vector>
 
 #include "Utilities.h"
+#include "SweepEncoder.h"
 
 // Frequency Settings
 #define FREQUENCY_STEP 100000U    // 100kHz frequency steps for initial frequency sweep
 #define START_FREQUENCY 50000000U // 50MHz
 #define STOP_FREQUENCY 110000000  // 110MHz
+// Below this reading at the maximum there is no resonance
+#define RESONANCE_MINIMUM_REFLECTION 130 // mV
+// Narrowest resonance dips of the probes, the dip is frequency / MAXIMUM_LOADED_Q wide
+#define MAXIMUM_LOADED_Q 150
+// Time the detector needs after a frequency change until its output is stable
+#define DETECTOR_CHARGE_TIME 100 // ms
+
+// Frequency the synthesizer was last set to, readings are cached per frequency
+static uint32_t current_frequency = 0;
+// Time of the last frequency change, a move after it also counts towards the charge time of the detector
+static unsigned long frequency_set_time = 0;
+
+int32_t findCurrentResonanceFrequency(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data, float *uncertainty)
+{
+  ResonanceEstimate estimate = estimateResonance(start_frequency, stop_frequency, frequency_step, print_data);
+  if (uncertainty != nullptr)
+    *uncertainty = estimate.uncertainty;
+  return estimate.frequency;
+}
 
-int32_t findCurrentResonanceFrequency(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data)
+ResonanceEstimate estimateResonance(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data)
 {
+  ResonanceEstimate estimate = {0, 0.0, 0};
   int maximum_reflection = 0;
   int current_reflection = 0;
   int current_phase = 0;
-  uint32_t minimum_frequency = 0;
+  size_t maximum_index = 0;
   float reflection = 0;
 
+  // Scans that start on the same grid measure the same frequencies, so repeated scans can reuse cached readings
+  if (measurementCache.isActive())
+    start_frequency -= start_frequency % frequency_step;
+
+  std::vector<int> reflections;
+  reflections.reserve((stop_frequency - start_frequency) / frequency_step + 1);
+
   setFrequency(start_frequency); // A frequency value needs to be set once -> there seems to be a bug with the first SPI call
   delay(50);
 
@@ -24,6 +54,7 @@ int32_t findCurrentResonanceFrequency(uint32_t start_frequency, uint32_t stop_fr
   {
     // setFrequency(frequency);
     setFrequency(frequency);
+    scheduler.yield();
 
     current_reflection = readReflection(8);
     current_phase = readPhase(1);
@@ -34,64 +65,361 @@ int32_t findCurrentResonanceFrequency(uint32_t start_frequency, uint32_t stop_fr
 
     if (current_reflection > maximum_reflection)
     {
-      minimum_frequency = frequency;
+      maximum_index = reflections.size();
       maximum_reflection = current_reflection;
     }
+    reflections.push_back(current_reflection);
   }
 
-  setFrequency(minimum_frequency);
+  uint32_t maximum_frequency = start_frequency + maximum_index * frequency_step;
+  setFrequency(maximum_frequency);
   delay(50);
   reflection = readReflection(16);
-  if (reflection < 130)
+  if (reflection < RESONANCE_MINIMUM_REFLECTION)
   {
     DEBUG_PRINT("Resonance could not be found.");
     DEBUG_PRINT(reflection);
-    return 0;
+    return estimate;
   }
 
-  // Capacitor needs to charge - therefore rerun around area with longer delay. -> REFACTOR THIS!!!!
-  maximum_reflection = 0;
-  for (uint32_t frequency = minimum_frequency - 300000U; frequency <= minimum_frequency + 300000U; frequency += frequency_step)
+  estimate.frequency = maximum_frequency;
+  estimate.reflection = reflection;
+  estimate.uncertainty = frequency_step / 2.0;
+
+  // At the edge of the scan there is no neighbour on both sides, so the grid frequency is all we know
+  if (maximum_index == 0 || maximum_index == reflections.size() - 1)
+    return estimate;
+
+  // Capacitor needs to charge - therefore the maximum and its neighbours are measured again with more averages.
+  // The peak is then interpolated with a parabola through these three points.
+  int remeasured[3];
+  float squared_difference = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    setFrequency(maximum_frequency + (i - 1) * (int32_t)frequency_step);
+    delay(10);
+    remeasured[i] = readReflection(16);
+
+    // The scan reading may come from the cache with the same or more averages, so the reference for the noise is read from the ADC directly
+    int reference = adac.read_ADC(MAGNITUDE, 8) * 1000;
+    squared_difference += pow(remeasured[i] - reference, 2);
+  }
+
+  // The difference between the 8 and 16 times averaged readings has three times the variance of a 16 times averaged reading
+  float noise = max(sqrt(squared_difference / 3.0 / 3.0), 1.0);
+
+  float uncertainty = 0;
+  float offset = interpolatePeak(remeasured[0], remeasured[1], remeasured[2], noise, &uncertainty);
+
+  estimate.frequency = lround(maximum_frequency + offset * frequency_step);
+  estimate.uncertainty = uncertainty * frequency_step;
+
+  DEBUG_PRINT(estimate.frequency);
+  DEBUG_PRINT(estimate.uncertainty);
+
+  return estimate;
+}
+
+// Resonance frequency found by the last adaptive search, used as prior for the next one
+static int32_t last_resonance_frequency = 0;
+
+// Scans the window and returns the frequency with the maximum reflection. If contrast is given the scan stops early as soon as
+// a peak that is high enough to be a resonance rises at least minimum_contrast above the readings on both sides of it.
+// contrast then returns the lower of both rises.
+static uint32_t scanForPeak(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, int minimum_contrast, int *contrast)
+{
+  // Windows that zoom in on the same peak overlap, on a common grid their readings can be reused
+  if (measurementCache.isActive())
+    start_frequency -= start_frequency % frequency_step;
+
+  int maximum_reflection = -1;
+  uint32_t maximum_frequency = start_frequency;
+  int minimum_before = 10e5; // lowest reading before the current maximum
+  int minimum_after = 10e5;  // lowest reading after the current maximum
+
+  setFrequency(start_frequency);
+  delay(10);
+
+  for (uint32_t frequency = start_frequency; frequency <= stop_frequency; frequency += frequency_step)
   {
     setFrequency(frequency);
+    scheduler.yield();
 
-    current_reflection = readReflection(64);
+    int current_reflection = readReflection(8);
 
     if (current_reflection > maximum_reflection)
     {
-      minimum_frequency = frequency;
+      // The old maximum and everything after it now lies before the new maximum
+      if (maximum_reflection >= 0)
+        minimum_before = min(minimum_before, min(minimum_after, maximum_reflection));
+      minimum_after = 10e5;
       maximum_reflection = current_reflection;
+      maximum_frequency = frequency;
     }
+    else
+    {
+      minimum_after = min(minimum_after, current_reflection);
+    }
+
+    // The peak is bracketed with enough contrast, the rest of the window does not need to be scanned.
+    // Bumps below the resonance level, e.g. at a filter edge, do not stop the scan since the real dip may follow
+    if ((contrast != nullptr) && (maximum_reflection >= RESONANCE_MINIMUM_REFLECTION) && (maximum_reflection - minimum_before >= minimum_contrast) && (maximum_reflection - minimum_after >= minimum_contrast))
+      break;
   }
 
-  return minimum_frequency;
+  if (contrast != nullptr)
+    *contrast = maximum_reflection - max(minimum_before, minimum_after);
+
+  return maximum_frequency;
 }
 
-void frequencySweep(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data, int averages)
+// Starts with a coarse scan of the window and zooms in around the peak until the fine frequency step is reached
+static ResonanceEstimate zoomResonance(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, uint32_t coarse_step)
+{
+  int MINIMUM_CONTRAST = 30; // ~1dB
+  uint32_t ZOOM_FACTOR = 5;
+
+  ResonanceEstimate estimate = {0, 0.0, 0};
+  uint32_t step = max(coarse_step, frequency_step);
+  uint32_t window_start = start_frequency;
+  uint32_t window_stop = stop_frequency;
+
+  // Only the first scan has to show a clear dip, the zoomed windows are too narrow for that
+  int contrast = 0;
+  int *required_contrast = &contrast;
+
+  while (step > frequency_step)
+  {
+    uint32_t peak_frequency = scanForPeak(window_start, window_stop, step, MINIMUM_CONTRAST, required_contrast);
+
+    if ((required_contrast != nullptr) && (contrast < MINIMUM_CONTRAST))
+    {
+      DEBUG_PRINT("No clear resonance dip found.");
+      return estimate;
+    }
+    required_contrast = nullptr;
+
+    window_start = max(peak_frequency - min(2 * step, peak_frequency), start_frequency);
+    window_stop = min(peak_frequency + 2 * step, stop_frequency);
+    step = max(step / ZOOM_FACTOR, frequency_step);
+  }
+
+  estimate = estimateResonance(window_start, window_stop, frequency_step);
+  if (estimate.frequency != 0)
+    last_resonance_frequency = estimate.frequency;
+
+  return estimate;
+}
+
+ResonanceEstimate findResonanceAdaptive(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step)
+{
+  uint32_t PRIOR_WINDOW = 2000000U;
+
+  // With a coarse step of one dip width at least one reading falls into the upper half of the dip, the dip is narrowest at the low end of the range
+  uint32_t coarse_step = start_frequency / MAXIMUM_LOADED_Q;
+
+  // If the last resonance lies in the range we first look only around it
+  if ((last_resonance_frequency >= (int32_t)start_frequency) && (last_resonance_frequency <= (int32_t)stop_frequency))
+  {
+    uint32_t window_start = max(last_resonance_frequency - (int32_t)PRIOR_WINDOW, (int32_t)start_frequency);
+    uint32_t window_stop = min(last_resonance_frequency + (int32_t)PRIOR_WINDOW, (int32_t)stop_frequency);
+    ResonanceEstimate estimate = zoomResonance(window_start, window_stop, frequency_step, min(PRIOR_WINDOW / 4, coarse_step));
+    if (estimate.frequency != 0)
+      return estimate;
+  }
+
+  return zoomResonance(start_frequency, stop_frequency, frequency_step, coarse_step);
+}
+
+float interpolatePeak(int left, int center, int right, float noise, float *uncertainty)
+{
+  float curvature = left - 2.0 * center + right;
+  float slope = 0.5 * (left - right);
+
+  // Without a maximum in the middle there is no parabola to fit
+  if (curvature >= 0)
+  {
+    *uncertainty = 0.5;
+    return 0.0;
+  }
+
+  float offset = slope / curvature;
+
+  // Propagate the noise of the three readings through offset = slope / curvature
+  float derivative_left = (0.5 * curvature - slope) / (curvature * curvature);
+  float derivative_center = 2.0 * slope / (curvature * curvature);
+  float derivative_right = (-0.5 * curvature - slope) / (curvature * curvature);
+  *uncertainty = noise * sqrt(derivative_left * derivative_left + derivative_center * derivative_center + derivative_right * derivative_right);
+
+  // The vertex can not be further away than the neighbouring points
+  offset = constrain(offset, -1.0f, 1.0f);
+  *uncertainty = min(*uncertainty, 1.0f);
+
+  return offset;
+}
+
+ResonatorModel fitResonatorModel(const int *reflections, uint16_t count, uint32_t start_frequency, uint32_t frequency_step)
+{
+  ResonatorModel model = {0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  int WING_POINTS = 3;
+  float MAXIMUM_ABSORPTION = 0.9999; // the readings of a perfect match are limited by the directivity anyway
+
+  if (count < 2 * WING_POINTS + 3)
+    return model;
+
+  // Far from the resonance everything is reflected, the lower wing is taken so a neighbouring dip does not lift it
+  float left_wing = 0;
+  float right_wing = 0;
+  for (int i = 0; i < WING_POINTS; i++)
+  {
+    left_wing += reflections[i] / (float)WING_POINTS;
+    right_wing += reflections[count - 1 - i] / (float)WING_POINTS;
+  }
+  float baseline = min(left_wing, right_wing);
+
+  int maximum_index = 0;
+  for (int i = 1; i < count; i++)
+  {
+    if (reflections[i] > reflections[maximum_index])
+      maximum_index = i;
+  }
+  if (maximum_index < WING_POINTS || maximum_index > count - 1 - WING_POINTS)
+    return model;
+
+  // Vertex of the parabola through the maximum and its neighbours
+  float uncertainty = 0;
+  float offset = interpolatePeak(reflections[maximum_index - 1], reflections[maximum_index], reflections[maximum_index + 1], 1.0, &uncertainty);
+  float peak = reflections[maximum_index] + 0.25 * (reflections[maximum_index + 1] - reflections[maximum_index - 1]) * offset;
+
+  // The readings are the return loss in dB times AD8302_MAGNITUDE_SLOPE, converted to absorbed power 1 - |G|^2
+  auto absorption = [baseline](float reflection)
+  { return 1.0 - pow(10, -(reflection - baseline) / (10 * AD8302_MAGNITUDE_SLOPE)); };
+
+  float peak_absorption = min((float)absorption(peak), MAXIMUM_ABSORPTION);
+  if (peak_absorption <= 0)
+    return model;
+
+  model.frequency = lround(start_frequency + (maximum_index + offset) * frequency_step);
+  model.reflection_coefficient = sqrt(1 - peak_absorption);
+  model.coupling = (1 - model.reflection_coefficient) / (1 + model.reflection_coefficient);
+  model.mismatch = -log(model.coupling);
+
+  // The loaded Q follows from the frequencies where half of the peak power is absorbed
+  float half_absorption = peak_absorption / 2;
+  float lower_frequency = 0;
+  float upper_frequency = 0;
+  for (int i = maximum_index; i > 0 && lower_frequency == 0; i--)
+  {
+    float inner = absorption(reflections[i]);
+    float outer = absorption(reflections[i - 1]);
+    if (outer < half_absorption && inner >= half_absorption)
+      lower_frequency = start_frequency + (i - (inner - half_absorption) / (inner - outer)) * frequency_step;
+  }
+  for (int i = maximum_index; i < count - 1 && upper_frequency == 0; i++)
+  {
+    float inner = absorption(reflections[i]);
+    float outer = absorption(reflections[i + 1]);
+    if (outer < half_absorption && inner >= half_absorption)
+      upper_frequency = start_frequency + (i + (inner - half_absorption) / (inner - outer)) * frequency_step;
+  }
+  if (lower_frequency == 0 || upper_frequency == 0)
+    return model;
+
+  model.loaded_q = model.frequency / (upper_frequency - lower_frequency);
+
+  // How well the Lorentzian describes the sweep tells if the model can be trusted
+  float squared_residual = 0;
+  for (int i = 0; i < count; i++)
+  {
+    float detuning = 2 * model.loaded_q * (start_frequency + i * (float)frequency_step - model.frequency) / model.frequency;
+    float modelled_absorption = peak_absorption / (1 + detuning * detuning);
+    float modelled_reflection = baseline - 10 * AD8302_MAGNITUDE_SLOPE * log10(1 - modelled_absorption);
+    squared_residual += pow(reflections[i] - modelled_reflection, 2);
+  }
+  model.residual = sqrt(squared_residual / count);
+
+  return model;
+}
+
+ResonatorModel measureResonatorModel(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step)
+{
+  std::vector<int> reflections;
+  reflections.reserve((stop_frequency - start_frequency) / frequency_step + 1);
+
+  setFrequency(start_frequency); // A frequency value needs to be set once -> there seems to be a bug with the first SPI call
+  delay(50);
+
+  for (uint32_t frequency = start_frequency; frequency <= stop_frequency; frequency += frequency_step)
+  {
+    setFrequency(frequency);
+    scheduler.yield();
+    reflections.push_back(readReflection(8));
+  }
+
+  ResonatorModel model = fitResonatorModel(reflections.data(), reflections.size(), start_frequency, frequency_step);
+
+  DEBUG_PRINT(model.frequency);
+  DEBUG_PRINT(model.loaded_q);
+  DEBUG_PRINT(model.coupling);
+
+  return model;
+}
+
+long predictTuningSteps(const ResonatorModel &model, uint32_t target_frequency, float tuning_slope)
+{
+  if (model.frequency == 0 || tuning_slope == 0)
+    return 0;
+
+  return lround(((int32_t)target_frequency - model.frequency) / tuning_slope);
+}
+
+long predictMatchingSteps(const ResonatorModel &model, float mismatch_slope, int rotation)
+{
+  if (model.frequency == 0 || mismatch_slope <= 0)
+    return 0;
+
+  return rotation * lround(model.mismatch / mismatch_slope);
+}
+
+int32_t frequencySweep(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data, int averages, boolean compact)
 {
   int current_reflection = 0;
   int current_phase = 0;
 
+  // Every sweep is kept in the sweep store so the data can be fetched again later
+  int32_t sweep_id = sweepStore.startSweep(start_frequency, frequency_step, averages);
+
   setFrequency(start_frequency); // A frequency value needs to be set once -> there seems to be a bug with the first SPI call
   delay(50);
 
+  // In compact mode no text lines may be sent between the header and the end of the binary data
+  SweepEncoder encoder;
+  if (print_data && compact)
+    encoder.begin(start_frequency, frequency_step, (stop_frequency - start_frequency) / frequency_step + 1, averages);
+
   for (uint32_t frequency = start_frequency; frequency <= stop_frequency; frequency += frequency_step)
   {
-    setFrequency(frequency);
+    setFrequency(frequency, !(print_data && compact));
+    scheduler.yield();
 
     current_reflection = readReflection(averages);
     current_phase = readPhase(1);
 
     // Send out the frequency identifier f with the frequency value
-    if (print_data)
+    if (print_data && compact)
+      encoder.addPoint(current_reflection, current_phase);
+    else if (print_data)
       Serial.println(String("f") + frequency + "r" + current_reflection + "p" + current_phase);
+
+    sweepStore.addPoint(current_reflection, current_phase);
   }
+
+  return sweep_id;
 }
 
-void setFrequency(uint32_t frequency)
+Filter getFilter(uint32_t frequency)
 {
-  // First we check what filter has to be used from the FILTERS array
-  // Then we set the filterbank accordingly
+  // We check what filter has to be used from the FILTERS array
   int i;
   for (i = 0; i < sizeof(FILTERS) / sizeof(FILTERS[0]); i++)
   {
@@ -105,26 +433,68 @@ void setFrequency(uint32_t frequency)
     else if ((frequency < FILTERS[i].fg) && (frequency > FILTERS[i - 1].fg))
       break;
   }
-  if (active_filter.fg != FILTERS[i].fg)
+
+  return FILTERS[i];
+}
+
+void setFrequency(uint32_t frequency, boolean print_info)
+{
+  // First we check what filter has to be used
+  // Then we set the filterbank accordingly
+  Filter filter = getFilter(frequency);
+  if (active_filter.fg != filter.fg)
   {
-    printInfo("Switching filter to: " + String(FILTERS[i].fg) + "Hz");
-    active_filter = FILTERS[i];
-    digitalWrite(FILTER_SWITCH_A, FILTERS[i].control_input_a);
-    digitalWrite(FILTER_SWITCH_B, FILTERS[i].control_input_b);
+    if (print_info)
+      printInfo("Switching filter to: " + String(filter.fg) + "Hz");
+    active_filter = filter;
+    digitalWrite(FILTER_SWITCH_A, filter.control_input_a);
+    digitalWrite(FILTER_SWITCH_B, filter.control_input_b);
   }
 
   // Finally we set the frequency
   adf4351.setf(frequency);
+  if (frequency != current_frequency)
+    frequency_set_time = millis();
+  current_frequency = frequency;
+}
+
+void waitForDetector()
+{
+  unsigned long elapsed = millis() - frequency_set_time;
+  if (elapsed < DETECTOR_CHARGE_TIME)
+    delay(DETECTOR_CHARGE_TIME - elapsed);
 }
 
 int readReflection(int averages)
 {
-  return (adac.read_ADC(MAGNITUDE, averages) * 1000);
+  // Every scan reads here, so no measurement loop can starve the watchdog
+  scheduler.yield();
+
+  int reflection;
+  if (measurementCache.findReflection(current_frequency, active_filter.fg, averages, &reflection))
+    return reflection;
+
+  reflection = adac.read_ADC(MAGNITUDE, averages) * 1000;
+  measurementCache.storeReflection(current_frequency, active_filter.fg, averages, reflection);
+  return reflection;
 }
 
 int readPhase(int averages)
 {
-  return (adac.read_ADC(PHASE, averages) * 1000);
+  scheduler.yield();
+
+  int phase;
+  if (measurementCache.findPhase(current_frequency, active_filter.fg, averages, &phase))
+    return phase;
+
+  phase = adac.read_ADC(PHASE, averages) * 1000;
+  measurementCache.storePhase(current_frequency, active_filter.fg, averages, phase);
+  return phase;
+}
+
+float reflectionToDb(int reflection)
+{
+  return (reflection - AD8302_MAGNITUDE_OFFSET) / AD8302_MAGNITUDE_SLOPE;
 }
 
 int sumReflectionAroundFrequency(uint32_t center_frequency)
@@ -135,6 +505,7 @@ int sumReflectionAroundFrequency(uint32_t center_frequency)
   for (uint32_t frequency = center_frequency - 500000U; frequency < center_frequency + 500000U; frequency += FREQUENCY_STEP / 10)
   {
     setFrequency(frequency);
+    scheduler.yield();
     sum_reflection += readReflection(16);
   }
 
@@ -147,175 +518,406 @@ int32_t bruteforceResonance(uint32_t target_frequency, uint32_t current_resonanc
   // Dir = 0 => Anticlockwise movement
   int rotation = 0; // rotation == 1 -> clockwise, rotation == -1 -> counterclockwise
 
-  int ITERATIONS = 25; // Iteration depth
-  int iteration_steps = 0;
+  int ITERATIONS = 25;                              // Iteration depth, only reached if the secant search fails
+  int32_t MAXIMUM_STEPS = 2 * STEPS_PER_ROTATION;   // A single predicted move is never larger than this
+  int32_t RESONANCE_TOLERANCE = FREQUENCY_STEP / 4; // Half the step size of the resonance scan
+  int32_t PROBE_STEPS = STEPS_PER_ROTATION / 20;
+  int32_t iteration_steps = 0;
 
   float MATCHING_THRESHOLD = 140; // if the reflection at the current resonance frequency is lower than this threshold re-matching is necessary -> calibrate to ~RL-8dB
   float resonance_reflection = 0;
 
-  int32_t delta_frequency = target_frequency - current_resonance_frequency;
+  int32_t target = target_frequency;
+  int32_t resonance = current_resonance_frequency;
+  int32_t delta_frequency = target - resonance;
 
   if (delta_frequency < 0)
     rotation = -1; // negative delta means currentresonance is too high, hence anticlockwise movement is necessary
   else
     rotation = 1;
 
-  int iteration_start = rotation * (STEPS_PER_ROTATION / 20);
+  // The last two measured points (tuner position, resonance frequency) are used for the secant prediction
+  long position = tuner.STEPPER.currentPosition();
+  long previous_position = 0;
+  int32_t previous_resonance = 0;
+  boolean previous_valid = false;
 
-  iteration_steps = iteration_start;
-  DEBUG_PRINT(iteration_start);
+  // Points where the resonance was below and above the target, used for regula falsi and the bisection fallback
+  boolean lower_found = false;
+  boolean upper_found = false;
+  long lower_position = 0;
+  long upper_position = 0;
+  int32_t lower_resonance = 0;
+  int32_t upper_resonance = 0;
+  int kept_side = 0; // counts how often in a row the lower (negative) or upper (positive) bracket end was kept
 
-  //'bruteforce' the stepper position to match the target frequency
+  // The first move is a small probe in the direction of the target to get the slope
+  iteration_steps = rotation * PROBE_STEPS;
+
+  sensitivity.observe(position, matcher.STEPPER.currentPosition(), resonance, 0);
 
   for (int i = 0; i < ITERATIONS; i++)
   {
     tuner.STEPPER.move(iteration_steps);
-    tuner.STEPPER.runToPosition();
 
-    // Only rematch matcher for large step width
-    if (iteration_steps == iteration_start)
+    // For large steps the matcher follows so the matching stays, how far is learned in the sensitivity matrix.
+    // A badly learned ratio must not run the matcher into its end stop, so the move is limited like a tuner move
+    if (abs(iteration_steps) >= PROBE_STEPS)
     {
-      matcher.STEPPER.move(-iteration_steps * 3);
-      matcher.STEPPER.runToPosition();
+      long compensation = constrain(sensitivity.matchingCompensation(iteration_steps), -(long)MAXIMUM_STEPS, (long)MAXIMUM_STEPS);
+      matcher.STEPPER.moveTo(limitToTravel(matcher.STEPPER.currentPosition() + compensation));
     }
 
-    // @ Optimization possibility: Reduce frequency range when close to target_frequency
-    current_resonance_frequency = findCurrentResonanceFrequency(current_resonance_frequency - 5000000U, current_resonance_frequency + 5000000U, FREQUENCY_STEP / 2);
+    // The reflection at the last resonance shows when the shafts are still after the move
+    setFrequency(resonance);
+    runSteppersToPositions();
+    settleModel.settle();
+
+    previous_position = position;
+    previous_resonance = resonance;
+    position = tuner.STEPPER.currentPosition();
+
+    int32_t measured_resonance = findResonanceAdaptive(resonance - 5000000, resonance + 5000000, FREQUENCY_STEP / 2).frequency;
+
+    DEBUG_PRINT(measured_resonance);
 
-    DEBUG_PRINT(current_resonance_frequency);
+    // If the resonance has been lost we go back halfway towards the last position where it was found
+    if (measured_resonance == 0)
+    {
+      sensitivity.forget();
+      previous_valid = false;
+      iteration_steps = -iteration_steps / 2;
+      if (iteration_steps == 0)
+        break;
+      continue;
+    }
+    resonance = measured_resonance;
 
     // Stops the iteration if the minima matches the target frequency
-    if (current_resonance_frequency == target_frequency)
+    if (abs(resonance - target) <= RESONANCE_TOLERANCE)
+    {
+      sensitivity.observe(position, matcher.STEPPER.currentPosition(), resonance, 0);
       break;
+    }
 
-    setFrequency(current_resonance_frequency);
-    delay(100);
+    setFrequency(resonance);
+    waitForDetector();
     resonance_reflection = readReflection(16);
     DEBUG_PRINT(resonance_reflection);
+    sensitivity.observe(position, matcher.STEPPER.currentPosition(), resonance, resonance_reflection);
 
     if (resonance_reflection < MATCHING_THRESHOLD)
     {
-      optimizeMatching(current_resonance_frequency);
+      optimizeMatching(resonance);
+
+      // Rematching shifts the resonance, so the points measured so far are not valid anymore
+      measured_resonance = findCurrentResonanceFrequency(resonance - 1000000, resonance + 1000000, FREQUENCY_STEP / 2);
+      if (measured_resonance == 0)
+        break;
+      resonance = measured_resonance;
+      sensitivity.observe(tuner.STEPPER.currentPosition(), matcher.STEPPER.currentPosition(), resonance, 0);
+      previous_valid = false;
+      lower_found = false;
+      upper_found = false;
+      kept_side = 0;
+    }
+
+    // Update the bracket around the target position
+    if (resonance < target)
+    {
+      kept_side = upper_found ? max(kept_side, 0) + 1 : 0;
+      lower_found = true;
+      lower_position = position;
+      lower_resonance = resonance;
+    }
+    else
+    {
+      kept_side = lower_found ? min(kept_side, 0) - 1 : 0;
+      upper_found = true;
+      upper_position = position;
+      upper_resonance = resonance;
     }
 
-    // This means the bruteforce resolution was too high and the resonance frequency overshoot
-    // therfore the turn direction gets inverted and the increment halfed
-    if ((current_resonance_frequency > target_frequency) && (rotation == 1))
+    long next_position;
+    if (lower_found && upper_found)
     {
-      rotation = -1;
-      iteration_steps /= 2;
-      iteration_steps *= rotation;
+      // The bracket can not be narrowed any further
+      if (abs(upper_position - lower_position) <= 1)
+        break;
+
+      // Regula falsi between the bracket ends. If one end is kept twice in a row its distance to the target is halved
+      // (Illinois method) so the search does not stall on one side
+      float lower_delta = lower_resonance - target;
+      float upper_delta = upper_resonance - target;
+      if (kept_side >= 2)
+        upper_delta /= 2;
+      else if (kept_side <= -2)
+        lower_delta /= 2;
+      next_position = lround(lower_position - lower_delta * (upper_position - lower_position) / (upper_delta - lower_delta));
+
+      // Fall back to bisection if the prediction is not strictly inside the bracket
+      if ((next_position - lower_position) * (next_position - upper_position) >= 0)
+        next_position = (lower_position + upper_position) / 2;
     }
-    else if ((current_resonance_frequency < target_frequency) && (rotation == -1))
+    else if (previous_valid && (position != previous_position) && ((float)(resonance - previous_resonance) / (position - previous_position) > 0))
     {
-      rotation = 1;
-      iteration_steps /= 2;
-      iteration_steps *= -rotation;
+      // Secant step through the last two points, the resonance frequency rises with the tuner position
+      float slope = (float)(resonance - previous_resonance) / (position - previous_position);
+      next_position = lround(position + (target - resonance) / slope);
     }
+    else
+    {
+      // No usable slope yet, probe further towards the target
+      rotation = (resonance < target) ? 1 : -1;
+      next_position = position + rotation * PROBE_STEPS;
+    }
+    previous_valid = true;
+
+    iteration_steps = constrain(next_position - position, -(long)MAXIMUM_STEPS, (long)MAXIMUM_STEPS);
+    DEBUG_PRINT(iteration_steps);
+    if (iteration_steps == 0)
+      break;
   }
 
-  return current_resonance_frequency;
+  return resonance;
 }
 
-int optimizeMatching(uint32_t current_resonance_frequency)
+// Moves the matcher to the position and returns the reflection at the resonance there, 0 if the resonance has been lost.
+// The resonance frequency is updated since the matcher also shifts it.
+static int measureMatchingAt(long position, int32_t &resonance_frequency, long matching_start, long tuning_start, float tuning_ratio)
 {
-  int ITERATIONS = 50;
-  int iteration_steps = 0;
+  // The tuner follows the matcher along a fixed line so the resonance stays where it is, neither may leave its travel
+  matcher.STEPPER.moveTo(limitToTravel(position));
+  tuner.STEPPER.moveTo(limitToTravel(tuning_start + lround(tuning_ratio * (position - matching_start))));
+
+  // The synthesizer is set to the last resonance while the steppers move, the reflection there shows when the shafts are still
+  startSteppersToPositions();
+  setFrequency(resonance_frequency);
+  motion.waitIdle();
+  settleModel.settle();
+
+  int32_t current_resonance_frequency = findCurrentResonanceFrequency(resonance_frequency - 1000000, resonance_frequency + 1000000, FREQUENCY_STEP / 2);
+  if (current_resonance_frequency == 0)
+    return 0;
+  resonance_frequency = current_resonance_frequency;
 
-  int maximum_reflection = 0;
-  int current_reflection = 0;
-  int minimum_matching_position = 0;
-  int last_reflection = 10e5;
-  int rotation = 1;
+  setFrequency(resonance_frequency);
+  waitForDetector();
 
-  // Look which rotation direction improves matching.
-  rotation = getMatchRotation(current_resonance_frequency);
+  int reflection = readReflection(16);
+  DEBUG_PRINT(position);
+  DEBUG_PRINT(reflection);
+  sensitivity.observe(tuner.STEPPER.currentPosition(), matcher.STEPPER.currentPosition(), resonance_frequency, reflection);
+  return reflection;
+}
 
-  DEBUG_PRINT(rotation);
+static void learnMatchRotation(uint32_t frequency, int phase, int rotation, int reflection)
+{
+  int MAXIMUM_WEIGHT = 8; // later samples keep a weight of 1/8, so the means follow slow drifts
 
-  // This tries to find the minimum reflection while ignoring the change in resonance -> it always looks for minima within
-  iteration_steps = rotation * (STEPS_PER_ROTATION / 20);
+  // The values of a point are the mean phase and the number of matchings it was averaged over.
+  // Only a point that the new one replaces anyway is continued, the phase of the cabling changes with the frequency
+  CalibrationMap &map = (rotation > 0) ? clockwisePhaseMap : anticlockwisePhaseMap;
+  int32_t values[CALIBRATION_VALUES];
+  if (map.lookup(frequency, values) >= CALIBRATION_MERGE_DISTANCE)
+  {
+    values[0] = phase;
+    values[1] = 0;
+  }
 
-  DEBUG_PRINT(iteration_steps);
+  values[1] = min(values[1] + 1, (int32_t)MAXIMUM_WEIGHT);
+  values[0] += lround((phase - values[0]) / (float)values[1]);
+  map.record(frequency, values, reflection);
+}
+
+int estimateMatchRotation(uint32_t current_resonance_frequency, int *phase)
+{
+  int MINIMUM_SAMPLES = 2;
+  float MINIMUM_SEPARATION = 100;       // mV, ~10 degrees
+  float PHASE_MARGIN = 0.25;            // part of the separation around the threshold where the direction is left open
+  uint32_t MAXIMUM_DISTANCE = 1000000U; // Hz, further away the phase of the cabling has changed too much
 
   setFrequency(current_resonance_frequency);
-  for (int i = 0; i < ITERATIONS; i++)
-  {
-    DEBUG_PRINT(i);
-    current_reflection = 0;
+  delay(10);
+  *phase = readPhase(16);
 
-    matcher.STEPPER.move(iteration_steps);
-    matcher.STEPPER.runToPosition();
+  // The means of both directions are interpolated from the matchings learned around this frequency
+  int32_t anticlockwise[CALIBRATION_VALUES];
+  int32_t clockwise[CALIBRATION_VALUES];
+  if (anticlockwisePhaseMap.lookup(current_resonance_frequency, anticlockwise) > MAXIMUM_DISTANCE || clockwisePhaseMap.lookup(current_resonance_frequency, clockwise) > MAXIMUM_DISTANCE)
+    return 0;
+  if (anticlockwise[1] < MINIMUM_SAMPLES || clockwise[1] < MINIMUM_SAMPLES)
+    return 0;
 
-    delay(50);
+  float separation = clockwise[0] - anticlockwise[0];
+  if (fabs(separation) < MINIMUM_SEPARATION)
+    return 0;
 
-    current_resonance_frequency = findCurrentResonanceFrequency(current_resonance_frequency - 1000000U, current_resonance_frequency + 1000000U, FREQUENCY_STEP / 2);
+  // Close to critical coupling the reflection is tiny and its phase is mostly noise
+  float threshold = (anticlockwise[0] + clockwise[0]) / 2.0;
+  float offset = (*phase - threshold) / separation;
+  if (fabs(offset) < PHASE_MARGIN)
+    return 0;
 
-    // Skip this iteration if the resonance has been lost
-    if (current_resonance_frequency == 0)
-    {
-      delay(1000); // Wait for one second since something has gone wrong
-      continue;
-    }
+  return (offset > 0) ? 1 : -1;
+}
 
-    setFrequency(current_resonance_frequency);
-    delay(100);
+int optimizeMatching(uint32_t current_resonance_frequency)
+{
+  int MAXIMUM_EVALUATIONS = 30;
+  long MAXIMUM_TRAVEL = 50 * (STEPS_PER_ROTATION / 20); // The same range the old fixed stepping covered
+  long POSITION_TOLERANCE = STEPS_PER_ROTATION / 100;
+  int REFLECTION_TOLERANCE = 3; // ~0.1dB, smaller improvements are not worth further moves
+  float GOLDEN_RATIO = 1.618034;
+  float GOLDEN_SECTION = 0.381966;
+
+  int32_t resonance_frequency = current_resonance_frequency;
+  int evaluations = 0;
+
+  // Look which rotation direction improves matching. The phase tells it without moving, probing is only needed until it has been learned.
+  int phase = 0;
+  int rotation = estimateMatchRotation(current_resonance_frequency, &phase);
+  if (rotation == 0)
+    rotation = getMatchRotation(current_resonance_frequency);
 
-    current_reflection = readReflection(16);
-    // current_reflection = sumReflectionAroundFrequency(current_resonance_frequency);
+  DEBUG_PRINT(rotation);
 
-    if (current_reflection > maximum_reflection)
-    {
-      minimum_matching_position = matcher.STEPPER.currentPosition();
-      maximum_reflection = current_reflection;
-      DEBUG_PRINT("Maximum");
-      DEBUG_PRINT(minimum_matching_position);
-    }
+  // First we bracket the maximum reflection: the reflection at b has to be higher than at a and c.
+  // The bracket grows by the golden ratio in the direction that improves matching.
+  long start_position = matcher.STEPPER.currentPosition();
+  long tuning_start = tuner.STEPPER.currentPosition();
+  float tuning_ratio = sensitivity.tuningRatio();
+  long a = start_position;
+  int reflection_a = measureMatchingAt(a, resonance_frequency, start_position, tuning_start, tuning_ratio);
+  long b = a + rotation * (STEPS_PER_ROTATION / 20);
+  int reflection_b = measureMatchingAt(b, resonance_frequency, start_position, tuning_start, tuning_ratio);
+  evaluations += 2;
+
+  if (reflection_b < reflection_a)
+  {
+    std::swap(a, b);
+    std::swap(reflection_a, reflection_b);
+  }
 
-    DEBUG_PRINT(matcher.STEPPER.currentPosition());
-    DEBUG_PRINT(current_resonance_frequency);
-    DEBUG_PRINT(last_reflection);
+  long c = b + lround(GOLDEN_RATIO * (b - a));
+  int reflection_c = measureMatchingAt(c, resonance_frequency, start_position, tuning_start, tuning_ratio);
+  evaluations++;
 
-    last_reflection = current_reflection;
+  while ((reflection_c > reflection_b) && (evaluations < MAXIMUM_EVALUATIONS) && (abs(c - start_position) < MAXIMUM_TRAVEL))
+  {
+    a = b;
+    reflection_a = reflection_b;
+    b = c;
+    reflection_b = reflection_c;
+    c = b + lround(GOLDEN_RATIO * (b - a));
+    reflection_c = measureMatchingAt(c, resonance_frequency, start_position, tuning_start, tuning_ratio);
+    evaluations++;
+  }
 
-    if (iteration_steps == 0)
+  // Then the bracket is narrowed with a golden section search until the position or the reflection converges
+  while ((reflection_c <= reflection_b) && (abs(c - a) > POSITION_TOLERANCE) && (evaluations < MAXIMUM_EVALUATIONS))
+  {
+    if ((reflection_b - reflection_a < REFLECTION_TOLERANCE) && (reflection_b - reflection_c < REFLECTION_TOLERANCE))
+      break;
+
+    // The new point is placed in the larger of the two intervals
+    long x;
+    if (abs(c - b) > abs(b - a))
+      x = b + lround(GOLDEN_SECTION * (c - b));
+    else
+      x = b - lround(GOLDEN_SECTION * (b - a));
+
+    if (x == b)
       break;
 
-    DEBUG_PRINT(current_reflection);
+    int reflection_x = measureMatchingAt(x, resonance_frequency, start_position, tuning_start, tuning_ratio);
+    evaluations++;
+
+    boolean x_towards_c = (x - b) * (c - b) > 0;
+    if (reflection_x > reflection_b)
+    {
+      // x is the new best point, the old best point becomes a bracket end
+      if (x_towards_c)
+      {
+        a = b;
+        reflection_a = reflection_b;
+      }
+      else
+      {
+        c = b;
+        reflection_c = reflection_b;
+      }
+      b = x;
+      reflection_b = reflection_x;
+    }
+    else if (x_towards_c)
+    {
+      c = x;
+      reflection_c = reflection_x;
+    }
+    else
+    {
+      a = x;
+      reflection_a = reflection_x;
+    }
   }
 
-  matcher.STEPPER.moveTo(minimum_matching_position);
-  matcher.STEPPER.runToPosition();
+  // If the travel limit stopped the bracketing, the last position is the best one
+  long maximum_position = b;
+  int maximum_reflection = reflection_b;
+  if (reflection_c > reflection_b)
+  {
+    maximum_position = c;
+    maximum_reflection = reflection_c;
+  }
+
+  DEBUG_PRINT("Maximum");
+  DEBUG_PRINT(maximum_position);
+  DEBUG_PRINT(evaluations);
+
+  // The positions were limited to the travel like in measureMatchingAt(), so the steppers go where the maximum was measured
+  maximum_position = limitToTravel(maximum_position);
+  matcher.STEPPER.moveTo(maximum_position);
+  tuner.STEPPER.moveTo(limitToTravel(tuning_start + lround(tuning_ratio * (maximum_position - start_position))));
+  runSteppersToPositions();
 
   DEBUG_PRINT(matcher.STEPPER.currentPosition());
 
+  // The direction the optimum actually was in belongs to the phase measured at the start
+  if (abs(maximum_position - start_position) > POSITION_TOLERANCE)
+    learnMatchRotation(current_resonance_frequency, phase, (maximum_position > start_position) ? 1 : -1, maximum_reflection);
+
   return (maximum_reflection);
 }
 
 int getMatchRotation(uint32_t current_resonance_frequency)
 {
+  // The reflection at the resonance shows when the matcher is still after the moves
+  setFrequency(current_resonance_frequency);
 
   matcher.STEPPER.move(STEPS_PER_ROTATION / 2);
-  matcher.STEPPER.runToPosition();
+  runStepperToPosition(matcher);
+  settleModel.settle();
 
   current_resonance_frequency = findCurrentResonanceFrequency(current_resonance_frequency - 1000000U, current_resonance_frequency + 1000000U, FREQUENCY_STEP / 10);
   // int clockwise_match = sumReflectionAroundFrequency(current_resonance_frequency);
   if (current_resonance_frequency != 0)
     setFrequency(current_resonance_frequency);
-  delay(100);
+  waitForDetector();
   int clockwise_match = readReflection(64);
 
   matcher.STEPPER.move(-2 * (STEPS_PER_ROTATION / 2));
-  matcher.STEPPER.runToPosition();
+  runStepperToPosition(matcher);
+  settleModel.settle();
 
   current_resonance_frequency = findCurrentResonanceFrequency(current_resonance_frequency - 1000000U, current_resonance_frequency + 1000000U, FREQUENCY_STEP / 10);
   // int anticlockwise_match = sumReflectionAroundFrequency(current_resonance_frequency);
   setFrequency(current_resonance_frequency);
-  delay(100);
+  waitForDetector();
   int anticlockwise_match = readReflection(64);
 
   matcher.STEPPER.move(STEPS_PER_ROTATION / 2);
-  matcher.STEPPER.runToPosition();
+  runStepperToPosition(matcher);
 
   DEBUG_PRINT(clockwise_match);
   DEBUG_PRINT(anticlockwise_match);
@@ -333,6 +935,7 @@ int stallStepper(Stepper stepper)
   while (!digitalRead(stepper.STALL_PIN))
   {
     stepper.STEPPER.run();
+    scheduler.yield();
   }
 
   DEBUG_PRINT(stepper.STEPPER.currentPosition());
@@ -349,7 +952,7 @@ long homeStepper(Stepper stepper)
   stallStepper(stepper);
   stepper.STEPPER.setCurrentPosition(0);
   stepper.STEPPER.moveTo(1000);
-  stepper.STEPPER.runToPosition();
+  runStepperToPosition(stepper);
 
   stepper.STEPPER.setMaxSpeed(3000);
   stepper.STEPPER.setAcceleration(3000);
@@ -358,20 +961,118 @@ long homeStepper(Stepper stepper)
   stallStepper(stepper);
   stepper.DRIVER.sg_stall_value(STALL_VALUE);
 
-  stepper.STEPPER.setMaxSpeed(12000);
-  stepper.STEPPER.setAcceleration(12000);
+  stepper.STEPPER.setMaxSpeed(STEPPER_MAX_SPEED);
+  stepper.STEPPER.setAcceleration(STEPPER_ACCELERATION);
 
   stepper.STEPPER.setCurrentPosition(0);
 
   stepper.STEPPER.moveTo(1000);
 
-  stepper.STEPPER.runToPosition();
+  runStepperToPosition(stepper);
 
   DEBUG_PRINT(stepper.STEPPER.currentPosition());
 
   return stepper.STEPPER.currentPosition();
 }
 
+void runStepperToPosition(Stepper &stepper)
+{
+  // Same as AccelStepper::runToPosition() but the background tasks keep running during the move
+  motion.moveTo(stepper, stepper.STEPPER.targetPosition());
+  motion.waitIdle();
+}
+
+void moveBacklashCorrected(Stepper &stepper, long position, long backlash)
+{
+  // Positions are always approached in positive direction, so moving back overshoots by the backlash first
+  if (position < stepper.STEPPER.currentPosition())
+  {
+    stepper.STEPPER.moveTo(position - backlash);
+    runStepperToPosition(stepper);
+  }
+
+  stepper.STEPPER.moveTo(position);
+  runStepperToPosition(stepper);
+}
+
+long limitToTravel(long position)
+{
+  if (!homed)
+    return position;
+
+  return constrain(position, STEPPER_MIN_POSITION, STEPPER_MAX_POSITION);
+}
+
+void runSteppersToPositions()
+{
+  startSteppersToPositions();
+  motion.waitIdle();
+}
+
+void startSteppersToPositions()
+{
+  long tuning_distance = labs(tuner.STEPPER.distanceToGo());
+  long matching_distance = labs(matcher.STEPPER.distanceToGo());
+  long longest_distance = max(tuning_distance, matching_distance);
+  if (longest_distance == 0)
+    return;
+
+  // The step generators share one profile that respects the limits of both steppers
+  if (tuner.GENERATOR != nullptr && matcher.GENERATOR != nullptr)
+  {
+    motion.moveBothTo(tuner.STEPPER.targetPosition(), matcher.STEPPER.targetPosition());
+    return;
+  }
+
+  // Scaling speed and acceleration by the same factor stretches the profile of the shorter move to the duration of the longer one
+  if (tuning_distance > 0)
+  {
+    float scale = (float)tuning_distance / longest_distance;
+    tuner.STEPPER.setMaxSpeed(STEPPER_MAX_SPEED * scale);
+    tuner.STEPPER.setAcceleration(STEPPER_ACCELERATION * scale);
+  }
+  if (matching_distance > 0)
+  {
+    float scale = (float)matching_distance / longest_distance;
+    matcher.STEPPER.setMaxSpeed(STEPPER_MAX_SPEED * scale);
+    matcher.STEPPER.setAcceleration(STEPPER_ACCELERATION * scale);
+  }
+
+  boolean tuning_running = true;
+  boolean matching_running = true;
+  while (tuning_running || matching_running)
+  {
+    tuning_running = tuner.STEPPER.run();
+    matching_running = matcher.STEPPER.run();
+    scheduler.yield();
+  }
+  settleModel.moveFinished(0, tuning_distance);
+  settleModel.moveFinished(1, matching_distance);
+
+  tuner.STEPPER.setMaxSpeed(STEPPER_MAX_SPEED);
+  tuner.STEPPER.setAcceleration(STEPPER_ACCELERATION);
+  matcher.STEPPER.setMaxSpeed(STEPPER_MAX_SPEED);
+  matcher.STEPPER.setAcceleration(STEPPER_ACCELERATION);
+}
+
+void moveSteppersBacklashCorrected(long tuning_position, long matching_position, long tuning_backlash, long matching_backlash)
+{
+  // An axis that moves back overshoots by its backlash while the other axis already moves to its target
+  boolean tuning_back = tuning_position < tuner.STEPPER.currentPosition();
+  boolean matching_back = matching_position < matcher.STEPPER.currentPosition();
+
+  tuner.STEPPER.moveTo(tuning_back ? tuning_position - tuning_backlash : tuning_position);
+  matcher.STEPPER.moveTo(matching_back ? matching_position - matching_backlash : matching_position);
+  runSteppersToPositions();
+
+  if (tuning_back || matching_back)
+  {
+    tuner.STEPPER.moveTo(tuning_position);
+    matcher.STEPPER.moveTo(matching_position);
+    runSteppersToPositions();
+  }
+}
+
 uint32_t validateInput(float frequency_MHz)
 {
   uint32_t frequency_Hz = frequency_MHz * 1000000U;
@@ -1,21 +1,127 @@
+#ifndef UTILITIES_H
+#define UTILITIES_H
+
 #include <math.h>
 #include <Arduino.h>
 #include "Debug.h"
 #include "global.h"
+#include "ResonatorModel.h"
+
+struct ResonanceEstimate
+{
+  int32_t frequency; // 0 if no resonance was found
+  float uncertainty; // standard deviation of the frequency in Hz
+  int reflection;    // reflection at the resonance in millivolts
+};
 
 /**
  * @brief This function finds the current resonance frequency of the coil. There should be a resonance already present or the algorithm might return nonsense.
- * It also returns the data of the frequency scan which can then be sent to the PC for plotting.
+ * It also returns the data of the frequency scan which can then be sent to the PC for plotting. The frequency is interpolated between the scan points, see estimateResonance.
  *
  * @param start_frequency The frequency at which the search should start
  * @param stop_frequency The frequency at which the search should stop
  * @param frequency_step The frequency step size
  * @param print_data If true, the data will be printed to the serial monitor -> defaults to false
+ * @param uncertainty If given, the standard deviation of the frequency in Hz is written here
  * @return int32_t The current resonance frequency
  *
  * @example findCurrentResonanceFrequency(START_FREQUENCY, STOP_FREQUENCY, FREQUENCY_STEP); // finds the current resonance frequency
  */
-int32_t findCurrentResonanceFrequency(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data = false);
+int32_t findCurrentResonanceFrequency(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data = false, float *uncertainty = nullptr);
+
+/**
+ * @brief This function finds the current resonance frequency like findCurrentResonanceFrequency but with sub-step resolution.
+ * The maximum of the scan and its two neighbours are measured again with more averages and the peak is interpolated with a parabola through them.
+ *
+ * @param start_frequency The frequency at which the search should start
+ * @param stop_frequency The frequency at which the search should stop
+ * @param frequency_step The frequency step size
+ * @param print_data If true, the data will be printed to the serial monitor -> defaults to false
+ * @return ResonanceEstimate The resonance frequency, its uncertainty and the reflection at resonance. The frequency is 0 if no resonance was found
+ *
+ * @example estimateResonance(80000000U, 90000000U, 100000U).uncertainty; // returns the uncertainty of the resonance between 80 and 90MHz in Hz
+ */
+ResonanceEstimate estimateResonance(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data = false);
+
+/**
+ * @brief This function finds the resonance frequency without scanning the whole range at the fine frequency step.
+ * It first scans coarse and stops as soon as a dip with enough contrast is bracketed, then zooms in around it until the frequency step is reached.
+ * The last found resonance is used as prior: if it lies in the range, only a small window around it is scanned first.
+ *
+ * @param start_frequency The frequency at which the search should start
+ * @param stop_frequency The frequency at which the search should stop
+ * @param frequency_step The final frequency step size
+ * @return ResonanceEstimate The resonance frequency, its uncertainty and the reflection at resonance. The frequency is 0 if no resonance was found
+ *
+ * @example findResonanceAdaptive(35000000U, 110000000U, 100000U); // finds the resonance between 35 and 110MHz with 100kHz resolution
+ */
+ResonanceEstimate findResonanceAdaptive(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step);
+
+/**
+ * @brief This function interpolates the position of a peak from three equally spaced readings with a parabola.
+ *
+ * @param left The reading one step before the maximum
+ * @param center The maximum reading
+ * @param right The reading one step after the maximum
+ * @param noise The standard deviation of a single reading
+ * @param uncertainty Returns the standard deviation of the peak position in steps
+ * @return float The position of the peak relative to the center in steps, between -1 and 1
+ *
+ * @example interpolatePeak(300, 400, 350, 2.0, &uncertainty); // returns 0.17
+ */
+float interpolatePeak(int left, int center, int right, float noise, float *uncertainty);
+
+/**
+ * @brief This function fits the model of a resonator with a coupling network to the reflection readings of a frequency sweep.
+ * The readings far from the resonance are taken as total reflection. Relative to them the absorbed power 1 - |G|^2 of the model is a Lorentzian
+ * with the height 4 b / (1 + b)^2 and the width f0 / QL, so the coupling b follows from the depth and the loaded Q from the width of the dip.
+ * Under- and overcoupling give the same magnitude, the side can only be told from the phase (see estimateMatchRotation).
+ *
+ * @param reflections The reflection readings in millivolts
+ * @param count The number of readings, the dip has to be inside with a few points on both sides
+ * @param start_frequency The frequency of the first reading
+ * @param frequency_step The frequency step between the readings
+ * @return ResonatorModel The fitted model, its frequency is 0 if there is no dip inside the sweep
+ *
+ * @example fitResonatorModel(reflections, 41, 83000000U, 50000U).loaded_q; // returns the loaded Q of the resonance between 83 and 85MHz
+ */
+ResonatorModel fitResonatorModel(const int *reflections, uint16_t count, uint32_t start_frequency, uint32_t frequency_step);
+
+/**
+ * @brief This function sweeps the frequency range and fits the resonator model to it, see fitResonatorModel.
+ *
+ * @param start_frequency The frequency at which the sweep should start
+ * @param stop_frequency The frequency at which the sweep should stop
+ * @param frequency_step The frequency step size
+ * @return ResonatorModel The fitted model, its frequency is 0 if there is no dip inside the sweep
+ *
+ * @example measureResonatorModel(83000000U, 85000000U, 50000U); // fits the resonator model between 83 and 85MHz
+ */
+ResonatorModel measureResonatorModel(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step);
+
+/**
+ * @brief This function predicts how many steps the tuner has to move to shift the resonance of the model to the target frequency.
+ *
+ * @param model The fitted model at the current position
+ * @param target_frequency The target frequency in Hz
+ * @param tuning_slope The shift of the resonance per tuner step in Hz
+ * @return long The tuner steps, 0 if the slope is not known
+ *
+ * @example predictTuningSteps(model, 84000000U, 1500.0); // returns 200 for a resonance at 83.7MHz
+ */
+long predictTuningSteps(const ResonatorModel &model, uint32_t target_frequency, float tuning_slope);
+
+/**
+ * @brief This function predicts how many steps the matcher has to move to reach critical coupling.
+ *
+ * @param model The fitted model at the current position
+ * @param mismatch_slope The change of the model mismatch per matcher step
+ * @param rotation The direction that improves the matching, see estimateMatchRotation
+ * @return long The matcher steps, 0 if the slope is not known
+ *
+ * @example predictMatchingSteps(model, 0.001, -1); // returns -400 for a mismatch of 0.4
+ */
+long predictMatchingSteps(const ResonatorModel &model, float mismatch_slope, int rotation);
 
 /**
  * @brief This function sweeps the frequency from start_frequency to stop_frequency with a step size of frequency_step.
@@ -25,18 +131,42 @@ int32_t findCurrentResonanceFrequency(uint32_t start_frequency, uint32_t stop_fr
  * @param stop_frequency
  * @param frequency_step
  * @param print_data
+ * @param averages
+ * @param compact If true, the data is sent in the delta encoded format of the SweepEncoder instead of one text line per point
+ * @return int32_t The id under which the data is kept in the sweep store, -1 if it could not be stored
+ */
+int32_t frequencySweep(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data = false, int averages = 4, boolean compact = false);
+
+/**
+ * @brief This function returns the filter of the filterbank that has to be used for the given frequency. It does not switch the filterbank.
+ *
+ * @param frequency The frequency that should be filtered
+ * @return Filter The filter from the FILTERS array
+ *
+ * @example getFilter(100000000U); // returns FG_120MHZ
  */
-void frequencySweep(uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step, boolean print_data = false, int averages = 4);
+Filter getFilter(uint32_t frequency);
 
 /**
  * @brief This function sets the frequency of the frequency synthesizer and switches the filterbank accordingly.
  *
  * @param frequency The frequency that should be set
+ * @param print_info If false, switching the filterbank is not reported -> defaults to true
  * @return void
  *
  * @example setFrequency(100000000U); // sets the frequency to 100MHz
  */
-void setFrequency(uint32_t frequency);
+void setFrequency(uint32_t frequency, boolean print_info = true);
+
+/**
+ * @brief This function waits until the detector output is stable after the last frequency change.
+ * Only the part of the charge time that has not passed yet is waited, so setting the frequency before a move saves the delay.
+ *
+ * @return void
+ *
+ * @example setFrequency(100000000U); runSteppersToPositions(); waitForDetector(); readReflection(16);
+ */
+void waitForDetector();
 
 /**
  * @brief This function reads the reflection at the current frequency. It does not set the frequency.
@@ -58,6 +188,16 @@ int readReflection(int averages);
  */
 int readPhase(int averages);
 
+/**
+ * @brief This function converts a reflection reading of the AD8302 to the return loss in dB.
+ *
+ * @param reflection The reflection in millivolts
+ * @return float The return loss in dB
+ *
+ * @example reflectionToDb(1320); // returns 14.0
+ */
+float reflectionToDb(int reflection);
+
 /**
  * @brief This function sums up the reflection around a given frequency.
  *
@@ -70,6 +210,8 @@ int sumReflectionAroundFrequency(uint32_t center_frequency);
 
 /**
  * @brief This function tries out different capacitor positions until iteration depth is reached OR current_resonancy frequency matches the target_frequency.
+ * The next tuner position is predicted with a secant through the last two measured points. Once the target is bracketed
+ * regula falsi is used, with bisection as fallback if the prediction leaves the bracket.
  *
  * @param target_frequency The frequency that should be matched
  * @param current_resonance_frequency The current resonance frequency
@@ -81,7 +223,8 @@ int32_t bruteforceResonance(uint32_t target_frequency, uint32_t current_resonanc
 
 /**
  * @brief This function tries to find a matching capacitor position that will decrease the reflection at the current resonance frequency to a minimum.
- * It will then move the stepper to this position.
+ * It will then move the stepper to this position. The optimum is bracketed in the direction from estimateMatchRotation, or from getMatchRotation if the phase
+ * does not tell the direction yet, and then narrowed with a golden section search until the position or the return loss converges.
  *
  * @param current_resonance_frequency The current resonance frequency
  * @return int The reflection at the minimum matching position
@@ -90,6 +233,20 @@ int32_t bruteforceResonance(uint32_t target_frequency, uint32_t current_resonanc
  */
 int optimizeMatching(uint32_t current_resonance_frequency);
 
+/**
+ * @brief This function infers the direction which the matching capacitor should be turned from the phase at the resonance, without moving the matcher.
+ * At the resonance the reflection coefficient is real and flips its sign between under- and overcoupling, so the AD8302 phase is on one side of a threshold
+ * for either direction. The threshold and which side belongs to which direction depend on the cabling, they are learned from the finished matching optimizations.
+ * The phases are kept per frequency in the NVS flash, only those learned within 1 MHz of the resonance are used.
+ *
+ * @param current_resonance_frequency The current resonance frequency
+ * @param phase The measured phase in millivolts is written here
+ * @return int 1 for clockwise, -1 for anticlockwise, 0 if the direction can not be told from the phase (yet)
+ *
+ * @example estimateMatchRotation(100000000, &phase); // returns the direction at 100MHz if enough matchings have been optimized near it before
+ */
+int estimateMatchRotation(uint32_t current_resonance_frequency, int *phase);
+
 /**
  * @brief This function finds the direction which the matching capacitor should be turned to decrease the reflection.
  *
@@ -120,6 +277,75 @@ int stallStepper(Stepper stepper);
  */
 long homeStepper(Stepper stepper);
 
+/**
+ * @brief This function moves the stepper to the target position of its AccelStepper and blocks until it is reached.
+ * It replaces AccelStepper::runToPosition() so the background tasks of the scheduler keep running during the move.
+ * The move is executed by the motion service, if the stepper has a step generator the steps are timed by the hardware, otherwise by AccelStepper::run().
+ *
+ * @param stepper The stepper that should be moved
+ * @return void
+ *
+ * @example tuner.STEPPER.move(100); runStepperToPosition(tuner); // moves the tuner 100 steps
+ */
+void runStepperToPosition(Stepper &stepper);
+
+/**
+ * @brief This function moves the stepper to an absolute position and always approaches it in positive direction,
+ * so the capacitor ends up at the same place independent of the direction it came from.
+ *
+ * @param stepper The stepper that should be moved
+ * @param position The absolute target position
+ * @param backlash The number of steps the stepper overshoots when it has to move in negative direction
+ * @return void
+ *
+ * @example moveBacklashCorrected(matcher, 20000, BACKLASH_STEPS); // moves the matcher to 20000 from below
+ */
+void moveBacklashCorrected(Stepper &stepper, long position, long backlash = BACKLASH_STEPS);
+
+/**
+ * @brief This function limits a target position to the travel of the capacitor shafts. Before homing the positions are not related
+ * to the end stop, then the position is returned unchanged.
+ *
+ * @param position The absolute target position
+ * @return long The position within STEPPER_MIN_POSITION and STEPPER_MAX_POSITION
+ *
+ * @example matcher.STEPPER.moveTo(limitToTravel(matcher.STEPPER.currentPosition() + compensation));
+ */
+long limitToTravel(long position);
+
+/**
+ * @brief This function moves the tuner and the matcher to their target positions at the same time and blocks until both are reached.
+ * The speed and acceleration of the shorter move are scaled down so both steppers finish together, a diagonal move takes as long as its longer axis.
+ *
+ * @return void
+ *
+ * @example tuner.STEPPER.moveTo(10000); matcher.STEPPER.moveTo(12000); runSteppersToPositions(); // moves both steppers at once
+ */
+void runSteppersToPositions();
+
+/**
+ * @brief This function starts the same move as runSteppersToPositions() but returns as soon as the moves are queued at the motion service.
+ * motion.waitIdle() waits until both steppers have arrived. Without step generators the moves are finished when it returns.
+ *
+ * @return void
+ *
+ * @example tuner.STEPPER.moveTo(10000); matcher.STEPPER.moveTo(12000); startSteppersToPositions(); setFrequency(83000000U); motion.waitIdle();
+ */
+void startSteppersToPositions();
+
+/**
+ * @brief This function moves the tuner and the matcher to absolute positions at the same time, both are approached in positive direction like in moveBacklashCorrected().
+ *
+ * @param tuning_position The absolute target position of the tuner
+ * @param matching_position The absolute target position of the matcher
+ * @param tuning_backlash The number of steps the tuner overshoots when it has to move in negative direction
+ * @param matching_backlash The number of steps the matcher overshoots when it has to move in negative direction
+ * @return void
+ *
+ * @example moveSteppersBacklashCorrected(15000, 20000); // moves the tuner to 15000 and the matcher to 20000 from below
+ */
+void moveSteppersBacklashCorrected(long tuning_position, long matching_position, long tuning_backlash = BACKLASH_STEPS, long matching_backlash = BACKLASH_STEPS);
+
 /**
  * @brief This function checks if the input is valid. It checks if the frequency is within the allowed range.
  *
@@ -157,4 +383,6 @@ void printInfo(uint32_t number);
  *
  * @example printError("Duck not found"); // prints "eDuck not found"
  */
-void printError(String text);
\ No newline at end of file
+void printError(String text);
+
+#endif
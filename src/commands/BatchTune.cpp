@@ -0,0 +1,145 @@
+#include <algorithm>
+
+#include "Utilities.h"
+#include "BatchTune.h"
+
+BatchTune::BatchTune(TuneMatch &tune_match) : tune_match(tune_match)
+{
+}
+
+void BatchTune::execute(String input_line)
+{
+    // Command format is l<frequency in MHz>,<frequency in MHz>,...
+    result = "";
+    if (!parseTargets(input_line.substring(1)))
+        return;
+
+    planOrder();
+
+    for (int index : order)
+    {
+        // Consecutive targets are close, so every target starts from the solution of the one before
+        uint32_t resonance_frequency = tune_match.tuneTo(targets[index], STRATEGY_TRACKING);
+
+        // Format is n<index>f<resonance frequency>u<uncertainty>r<reflection>p<phase>t<tuning position>m<matching position>, the index is the position in the sent list.
+        // The prefix differs from the l lines of the sweep list (gl)
+        String text = "n" + String(index) + "f" + String(resonance_frequency);
+        if (resonance_frequency != 0)
+            text += "u" + String(lround(tune_match.getUncertainty())) + "r" + String(tune_match.getReflection()) + "p" + String(readPhase(16)) + "t" + String(tuner.STEPPER.currentPosition()) + "m" + String(matcher.STEPPER.currentPosition());
+        Serial.println(text);
+    }
+}
+
+boolean BatchTune::parseTargets(String frequency_list)
+{
+    targets.clear();
+
+    while (frequency_list.length() > 0)
+    {
+        int delimiter_index = frequency_list.indexOf(',');
+        String frequency = (delimiter_index == -1) ? frequency_list : frequency_list.substring(0, delimiter_index);
+
+        uint32_t target_frequency = validateInput(frequency.toFloat());
+        if (target_frequency == 0)
+        {
+            result = "Invalid frequency in batch";
+            return false;
+        }
+        if (targets.size() == MAX_BATCH_TARGETS)
+        {
+            result = "Too many frequencies in batch";
+            return false;
+        }
+        targets.push_back(target_frequency);
+
+        if (delimiter_index == -1)
+            break;
+        frequency_list = frequency_list.substring(delimiter_index + 1);
+    }
+
+    if (targets.empty())
+    {
+        result = "No frequencies in batch";
+        return false;
+    }
+
+    return true;
+}
+
+// Sums up the steps of the longer axis over all moves of the path, both steppers move at once. Moves down also cost the backlash overshoot
+static long pathTravel(const std::vector<int> &order, const std::vector<long> &tuning_positions, const std::vector<long> &matching_positions)
+{
+    long travel = 0;
+    long tuning_position = tuner.STEPPER.currentPosition();
+    long matching_position = matcher.STEPPER.currentPosition();
+    for (int index : order)
+    {
+        travel += max(labs(tuning_positions[index] - tuning_position), labs(matching_positions[index] - matching_position));
+
+        // Positions are approached from below, moving down overshoots by the backlash and comes back
+        if (tuning_positions[index] < tuning_position || matching_positions[index] < matching_position)
+            travel += 2 * BACKLASH_STEPS;
+        tuning_position = tuning_positions[index];
+        matching_position = matching_positions[index];
+    }
+    return travel;
+}
+
+void BatchTune::planOrder()
+{
+    // Sorting the targets by predicted tuner position gives a path through all of them without any reversal.
+    // Without learned positions the frequency is used instead.
+    boolean predicted = homed && positionMap.getCount() > 0;
+    std::vector<long> tuning_positions(targets.size());
+    std::vector<long> matching_positions(targets.size());
+    std::vector<std::pair<long, int>> keys(targets.size());
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        keys[i] = std::make_pair((long)targets[i], (int)i);
+        if (predicted)
+        {
+            int32_t positions[CALIBRATION_VALUES];
+            positionMap.lookup(targets[i], positions);
+            tuning_positions[i] = positions[0];
+            matching_positions[i] = positions[1];
+            keys[i].first = positions[0];
+        }
+    }
+    std::stable_sort(keys.begin(), keys.end());
+
+    order.resize(targets.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = keys[i].second;
+
+    if (!predicted)
+        return;
+
+    // The path starts at the end that the tuner and the matcher reach faster
+    std::vector<int> reversed_order(order.rbegin(), order.rend());
+    long travel = pathTravel(order, tuning_positions, matching_positions);
+    long reversed_travel = pathTravel(reversed_order, tuning_positions, matching_positions);
+    if (reversed_travel < travel)
+    {
+        order = reversed_order;
+        travel = reversed_travel;
+    }
+
+    printInfo("Planned travel " + String(travel) + " steps");
+}
+
+void BatchTune::printResult()
+{
+    if (result.length() > 0)
+        printError(result);
+    // This tells the PC that all targets are done
+    Serial.println("l");
+}
+
+void BatchTune::printHelp()
+{
+    Serial.println("Batch tune and match command");
+    Serial.println("Syntax: l<frequency in MHz>,<frequency in MHz>,...");
+    Serial.println("Example: l85.3,83.1,84.2");
+    Serial.println("This will tune and match to all three frequencies in the order of the tuner position, starting from the end closer to the current positions, and measure the reflection and phase.");
+    Serial.println("Every result line n<index>f<resonance frequency>u<uncertainty in Hz>r<reflection>p<phase>t<tuning position>m<matching position> carries the index of the frequency in the sent list.");
+}
@@ -0,0 +1,37 @@
+#ifndef BATCHTUNE_H
+#define BATCHTUNE_H
+
+#include <vector>
+#include "Command.h"
+#include "TuneMatch.h"
+
+// Maximum number of target frequencies of one batch
+#define MAX_BATCH_TARGETS 64
+
+/**
+ * @brief This class is used to tune and match to a list of target frequencies in one command.
+ * The targets are not tuned in the order they are sent but in the order of their learned tuner positions, so the capacitors do not swing back and forth.
+ * The order starts at the end that the tuner and the matcher reach faster from their current positions.
+ */
+class BatchTune : public Command
+{
+public:
+    BatchTune(TuneMatch &tune_match);
+    /**
+     * @brief This function tunes and matches to all target frequencies and prints the result of every target.
+     * @param input_line The input line from the serial monitor. The syntax is l<frequency in MHz>,<frequency in MHz>,...
+     */
+    void execute(String input_line) override;
+    void printResult() override;
+    void printHelp() override;
+
+private:
+    boolean parseTargets(String frequency_list);
+    void planOrder();
+    TuneMatch &tune_match;
+    std::vector<uint32_t> targets;
+    std::vector<int> order; // indices into targets in the order they are tuned
+    String result;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "Utilities.h"
+#include "BaudRate.h"
+
+// Time in ms the PC has to reopen its port and send the echo line at the new baud rate
+#define LINK_TIMEOUT 2000
+
+// Baud rates the CP2102/CH340 USB bridges of the ESP32 dev boards can handle
+const uint32_t SUPPORTED_BAUD_RATES[] = {115200U, 230400U, 460800U, 921600U, 1000000U, 1500000U, 2000000U, 3000000U};
+
+void BaudRate::execute(String input_line)
+{
+    // Command format is b<baud rate>
+    // Example: b921600
+    link_verified = false;
+
+    // Without a baud rate we only report the active one, e.g. after the PC fell back to the old rate
+    if (input_line.length() <= 1)
+        return;
+
+    uint32_t baud_rate = input_line.substring(1).toInt();
+    if (!isSupported(baud_rate))
+    {
+        printError("Unsupported baud rate: " + String(baud_rate));
+        return;
+    }
+
+    uint32_t old_baud_rate = Serial.baudRate();
+    printInfo("Switching baud rate to " + String(baud_rate));
+
+    // Everything has to be sent at the old baud rate before we switch
+    Serial.flush();
+    Serial.updateBaudRate(baud_rate);
+
+    // The PC now switches its port and sends the proposal again, which we echo back at the new baud rate
+    link_verified = verifyLink("b" + String(baud_rate));
+
+    if (!link_verified)
+    {
+        Serial.flush();
+        Serial.updateBaudRate(old_baud_rate);
+        printError("Link test failed, falling back to " + String(old_baud_rate));
+    }
+}
+
+bool BaudRate::isSupported(uint32_t baud_rate)
+{
+    for (int i = 0; i < sizeof(SUPPORTED_BAUD_RATES) / sizeof(SUPPORTED_BAUD_RATES[0]); i++)
+    {
+        if (SUPPORTED_BAUD_RATES[i] == baud_rate)
+            return true;
+    }
+    return false;
+}
+
+bool BaudRate::verifyLink(String expected_line)
+{
+    String received_line = "";
+    unsigned long start_time = millis();
+
+    // Bytes received while the PC was still switching are garbage
+    while (Serial.available())
+        Serial.read();
+
+    while (millis() - start_time < LINK_TIMEOUT)
+    {
+        scheduler.yield();
+        if (!Serial.available())
+            continue;
+
+        char received = Serial.read();
+        if (received == '\r')
+            continue;
+
+        if (received == '\n')
+        {
+            Serial.println(received_line);
+            return received_line == expected_line;
+        }
+
+        received_line += received;
+    }
+
+    return false;
+}
+
+void BaudRate::printResult()
+{
+    // Format is b<active baud rate>
+    Serial.println("b" + String(Serial.baudRate()));
+}
+
+void BaudRate::printHelp()
+{
+    Serial.println("Baud rate command");
+    Serial.println("Syntax: b<baud rate>");
+    Serial.println("Example: b921600");
+    Serial.println("This will switch the serial link to 921600 baud. The PC has to switch its port and send b921600 within 2 s, otherwise the old baud rate is restored.");
+    Serial.println("Syntax: b");
+    Serial.println("This will print the active baud rate");
+}
@@ -0,0 +1,27 @@
+#ifndef BAUDRATE_H
+#define BAUDRATE_H
+
+#include "Command.h"
+
+/**
+ * @brief This class is used to negotiate a faster serial link with the PC.
+ * The new baud rate is only kept if the PC echoes the proposal back at the new rate within LINK_TIMEOUT, otherwise the old rate is restored.
+ */
+class BaudRate : public Command
+{
+public:
+    /**
+     * @brief This function switches the serial link to the proposed baud rate and verifies it with an echo test.
+     * @param input_line The input line from the serial monitor. The syntax is b<baud rate>. Without a baud rate the active rate is only reported.
+     */
+    void execute(String input_line) override;
+    void printResult() override;
+    void printHelp() override;
+
+private:
+    bool isSupported(uint32_t baud_rate);
+    bool verifyLink(String expected_line);
+    bool link_verified;
+};
+
+#endif
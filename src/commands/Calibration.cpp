@@ -0,0 +1,125 @@
+#include <vector>
+
+#include "Utilities.h"
+#include "Calibration.h"
+
+// Calibration maps
+#define POSITION_MAP 'p' // tuner and matcher positions in steps
+#define VOLTAGE_MAP 'v'  // tuning and matching voltages in mV
+
+#define CLEAR 'c'
+#define EXPORT 'e'
+#define IMPORT 'i'
+
+void Calibration::execute(String input_line)
+{
+    // Command format is k<map><action>, without action the map is listed
+    result = "";
+    char map_identifier = input_line[1];
+    char action = input_line[2];
+
+    CalibrationMap *map;
+    if (map_identifier == POSITION_MAP)
+        map = &positionMap;
+    else if (map_identifier == VOLTAGE_MAP)
+        map = &voltageMap;
+    else
+    {
+        result = "Unknown calibration map";
+        return;
+    }
+
+    if (action == CLEAR)
+    {
+        map->clear();
+        printInfo("Calibration map cleared");
+    }
+    else if (action == EXPORT)
+        exportMap(map);
+    else if (action == IMPORT)
+        importMap(map, input_line.substring(3));
+    else
+        printPoints(map);
+}
+
+void Calibration::printPoints(CalibrationMap *map)
+{
+    // Format is k<frequency>t<tuning value>m<matching value>r<reflection>
+    for (uint16_t i = 0; i < map->getCount(); i++)
+    {
+        const CalibrationPoint *point = map->getPoint(i);
+        Serial.println("k" + String(point->frequency) + "t" + String(point->values[0]) + "m" + String(point->values[1]) + "r" + String(point->reflection));
+    }
+    printInfo(String(map->getCount()) + " learned points");
+}
+
+void Calibration::exportMap(CalibrationMap *map)
+{
+    // Format is x<data as hex string>
+    const char HEX_DIGITS[] = "0123456789abcdef";
+    std::vector<uint8_t> data(map->getCount() * CALIBRATION_POINT_BYTES);
+    size_t length = map->exportData(data.data());
+
+    String hex = "x";
+    hex.reserve(2 * length + 1);
+    for (size_t i = 0; i < length; i++)
+    {
+        hex += HEX_DIGITS[data[i] >> 4];
+        hex += HEX_DIGITS[data[i] & 0x0F];
+    }
+    Serial.println(hex);
+}
+
+void Calibration::importMap(CalibrationMap *map, String hex)
+{
+    hex.trim();
+    if (hex.length() % 2 != 0)
+    {
+        result = "Invalid calibration data";
+        return;
+    }
+
+    std::vector<uint8_t> data(hex.length() / 2);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        char *end;
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+        data[i] = strtoul(byte, &end, 16);
+        if (*end != '\0')
+        {
+            result = "Invalid calibration data";
+            return;
+        }
+    }
+
+    if (!map->importData(data.data(), data.size()))
+    {
+        result = "Invalid calibration data";
+        return;
+    }
+    printInfo(String(map->getCount()) + " points imported");
+}
+
+void Calibration::printResult()
+{
+    if (result.length() > 0)
+        printError(result);
+    // This tells the PC that all data has been sent
+    Serial.println("k");
+}
+
+void Calibration::printHelp()
+{
+    Serial.println("Calibration command");
+    Serial.println("Syntax: k<map><action>");
+    Serial.println("Maps: p for the tuner and matcher positions, v for the tuning and matching voltages in mV");
+    Serial.println("Example: kp");
+    Serial.println("This will list the learned tuner and matcher positions");
+    Serial.println("Example: kpc");
+    Serial.println("This will clear the learned tuner and matcher positions");
+    Serial.println("Example: kve");
+    Serial.println("This will print the learned voltages as hex string x<data>");
+    Serial.println("Example: kvi<data>");
+    Serial.println("This will replace the learned voltages with exported data");
+    Serial.println("The positions are learned after every successful tune and match and are only used after homing, the voltages after every voltage sweep");
+}
@@ -0,0 +1,28 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "Command.h"
+#include "CalibrationMap.h"
+
+/**
+ * @brief This class is used to inspect, reset and back up the calibration maps that are learned while tuning and matching.
+ */
+class Calibration : public Command
+{
+public:
+    /**
+     * @brief This function lists, clears, exports or imports a calibration map.
+     * @param input_line The input line from the serial monitor. The syntax is k<map><action>, e.g. kp lists and kpc clears the position map, kve exports and kvi<data> imports the voltage map.
+     */
+    void execute(String input_line) override;
+    void printResult() override;
+    void printHelp() override;
+
+private:
+    void printPoints(CalibrationMap *map);
+    void exportMap(CalibrationMap *map);
+    void importMap(CalibrationMap *map, String hex);
+    String result;
+};
+
+#endif
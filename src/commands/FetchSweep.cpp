@@ -0,0 +1,209 @@
+#include <vector>
+
+#include "Utilities.h"
+#include "SweepEncoder.h"
+#include "FetchSweep.h"
+
+#define SUMMARY 's'
+#define LIST 'l'
+
+// Views of the sweep data
+#define VIEW_RAW 'r'     // f<frequency>r<reflection>p<phase> like the frequency sweep
+#define VIEW_DB 'd'      // f<frequency>d<return loss in dB>
+#define VIEW_PHASE 'p'   // f<frequency>p<phase>
+#define VIEW_COMPACT 'c' // delta encoded format of the SweepEncoder
+
+void FetchSweep::execute(String input_line)
+{
+    // Command format is g<sweep id>,<first point>,<last point>,<decimation><view>
+    // Everything after the sweep id is optional, e.g. g3 fetches all points of sweep 3 in the raw view
+    result = "";
+    char action = input_line[1];
+
+    if (action == LIST)
+    {
+        printList();
+        return;
+    }
+
+    int first_parameter = (action == SUMMARY) ? 2 : 1;
+    String parameters = input_line.substring(first_parameter);
+    int32_t id = parameters.toInt();
+
+    const SweepHeader *header = sweepStore.getHeader(id);
+    if (parameters.length() == 0 || header == nullptr)
+    {
+        result = "Sweep not stored";
+        return;
+    }
+
+    if (action == SUMMARY)
+    {
+        printSummary(id);
+        return;
+    }
+
+    // The view is given by the last character, digits mean no view was given
+    char view = parameters[parameters.length() - 1];
+    if (isDigit(view))
+        view = VIEW_RAW;
+
+    uint16_t first_point = 0;
+    uint16_t last_point = header->count - 1;
+    uint16_t decimation = 1;
+
+    int delimiter_index = parameters.indexOf(',');
+    if (delimiter_index != -1)
+    {
+        parameters = parameters.substring(delimiter_index + 1);
+        first_point = parameters.toInt();
+        delimiter_index = parameters.indexOf(',');
+    }
+    if (delimiter_index != -1)
+    {
+        parameters = parameters.substring(delimiter_index + 1);
+        last_point = min((uint16_t)parameters.toInt(), last_point);
+        delimiter_index = parameters.indexOf(',');
+    }
+    if (delimiter_index != -1)
+    {
+        parameters = parameters.substring(delimiter_index + 1);
+        decimation = max((uint16_t)parameters.toInt(), (uint16_t)1);
+    }
+
+    if (header->count == 0 || first_point > last_point)
+    {
+        result = "Invalid point range";
+        return;
+    }
+
+    printPoints(id, first_point, last_point, decimation, view);
+}
+
+void FetchSweep::printPoints(int32_t id, uint16_t first_point, uint16_t last_point, uint16_t decimation, char view)
+{
+    const SweepHeader *header = sweepStore.getHeader(id);
+
+    if (view == VIEW_COMPACT)
+    {
+        // The decimation simply increases the frequency step of the encoded sweep
+        SweepEncoder encoder;
+        encoder.begin(sweepStore.getFrequency(id, first_point), header->frequency_step * decimation, (last_point - first_point) / decimation + 1, header->averages);
+        for (uint32_t i = first_point; i <= last_point; i += decimation)
+        {
+            encoder.addPoint(sweepStore.getReflection(id, i), sweepStore.getPhase(id, i));
+            scheduler.yield();
+        }
+        return;
+    }
+
+    // At a low baud rate a long sweep takes longer to print than the watchdog timeout
+    for (uint32_t i = first_point; i <= last_point; i += decimation)
+    {
+        scheduler.yield();
+        uint32_t frequency = sweepStore.getFrequency(id, i);
+
+        if (view == VIEW_DB)
+            Serial.println(String("f") + frequency + "d" + String(reflectionToDb(sweepStore.getReflection(id, i))));
+        else if (view == VIEW_PHASE)
+            Serial.println(String("f") + frequency + "p" + sweepStore.getPhase(id, i));
+        else
+            Serial.println(String("f") + frequency + "r" + sweepStore.getReflection(id, i) + "p" + sweepStore.getPhase(id, i));
+    }
+}
+
+void FetchSweep::printSummary(int32_t id)
+{
+    const SweepHeader *header = sweepStore.getHeader(id);
+
+    uint16_t minimum_reflection = 0xFFFF;
+    uint16_t maximum_reflection = 0;
+    uint16_t minimum_index = 0;
+    uint16_t maximum_index = 0;
+    uint16_t minimum_phase = 0xFFFF;
+    uint16_t maximum_phase = 0;
+
+    for (uint16_t i = 0; i < header->count; i++)
+    {
+        uint16_t reflection = sweepStore.getReflection(id, i);
+        uint16_t phase = sweepStore.getPhase(id, i);
+
+        if (reflection < minimum_reflection)
+        {
+            minimum_reflection = reflection;
+            minimum_index = i;
+        }
+        // The maximum reflection value is the resonance
+        if (reflection > maximum_reflection)
+        {
+            maximum_reflection = reflection;
+            maximum_index = i;
+        }
+        minimum_phase = min(phase, minimum_phase);
+        maximum_phase = max(phase, maximum_phase);
+    }
+
+    // A stored sweep has no repeated readings, so the noise is estimated from the second differences of neighbouring points.
+    // For a smooth curve they are mostly noise, (r[i-1] - 2 r[i] + r[i+1]) has six times the variance of a single reading
+    float squared_difference = 0;
+    for (uint16_t i = 1; i + 1 < header->count; i++)
+        squared_difference += pow(sweepStore.getReflection(id, i - 1) - 2.0 * sweepStore.getReflection(id, i) + sweepStore.getReflection(id, i + 1), 2);
+    float noise = (header->count > 2) ? max(sqrt(squared_difference / (header->count - 2) / 6.0), 1.0) : 1.0;
+
+    // The resonance is interpolated between the points around the maximum, at the edge of the sweep the grid frequency is all we know
+    float peak_offset = 0;
+    float uncertainty = 0.5;
+    if (maximum_index > 0 && maximum_index < header->count - 1)
+        peak_offset = interpolatePeak(sweepStore.getReflection(id, maximum_index - 1), maximum_reflection, sweepStore.getReflection(id, maximum_index + 1), noise, &uncertainty);
+    uint32_t peak_frequency = lround(sweepStore.getFrequency(id, maximum_index) + peak_offset * header->frequency_step);
+    uint32_t peak_uncertainty = lround(uncertainty * header->frequency_step);
+
+    // The resonator model gives the loaded Q and the coupling of the probe
+    std::vector<int> reflections(header->count);
+    for (uint16_t i = 0; i < header->count; i++)
+        reflections[i] = sweepStore.getReflection(id, i);
+    ResonatorModel model = fitResonatorModel(reflections.data(), header->count, header->start_frequency, header->frequency_step);
+
+    // Format is s<sweep id>,<points>,<minimum reflection>,<frequency of minimum>,<maximum reflection>,<frequency of maximum>,<minimum phase>,<maximum phase>,<interpolated resonance frequency>,
+    // <model resonance frequency>,<loaded Q>,<coupling>,<model residual>,<uncertainty of the interpolated resonance frequency>
+    Serial.println("s" + String(id) + "," + String(header->count) + "," + String(minimum_reflection) + "," + String(sweepStore.getFrequency(id, minimum_index)) + "," + String(maximum_reflection) + "," + String(sweepStore.getFrequency(id, maximum_index)) + "," + String(minimum_phase) + "," + String(maximum_phase) + "," + String(peak_frequency) + "," +
+                   String(model.frequency) + "," + String(model.loaded_q, 1) + "," + String(model.coupling, 3) + "," + String(model.residual, 1) + "," + String(peak_uncertainty));
+}
+
+void FetchSweep::printList()
+{
+    // Format is l<sweep id>,<start frequency>,<frequency step>,<points>,<averages> for every stored sweep
+    for (uint16_t slot = 0; slot < sweepStore.getSlots(); slot++)
+    {
+        const SweepHeader *header = sweepStore.getSlotHeader(slot);
+        if (header->id == -1)
+            continue;
+
+        Serial.println("l" + String(header->id) + "," + String(header->start_frequency) + "," + String(header->frequency_step) + "," + String(header->count) + "," + String(header->averages));
+    }
+}
+
+void FetchSweep::printResult()
+{
+    if (result.length() > 0)
+        printError(result);
+    // This tells the PC that all data has been sent
+    Serial.println("g");
+}
+
+void FetchSweep::printHelp()
+{
+    Serial.println("Fetch sweep command");
+    Serial.println("Syntax: g<sweep id>,<first point>,<last point>,<decimation><view>");
+    Serial.println("Example: g3,0,200,4d");
+    Serial.println("This will print every fourth point of the first 201 points of sweep 3 as return loss in dB");
+    Serial.println("Everything after the sweep id is optional. Possible views:");
+    Serial.println("r: reflection and phase in mV (default)");
+    Serial.println("d: return loss in dB");
+    Serial.println("p: phase in mV");
+    Serial.println("c: compact delta encoded format");
+    Serial.println("Syntax: gs<sweep id>");
+    Serial.println("This will print the minimum and maximum reflection and phase of the sweep, the interpolated resonance frequency, the fitted resonator model (resonance frequency, loaded Q, coupling, residual) and the uncertainty of the interpolated resonance frequency in Hz");
+    Serial.println("Syntax: gl");
+    Serial.println("This will list all stored sweeps");
+}
@@ -0,0 +1,28 @@
+#ifndef FETCHSWEEP_H
+#define FETCHSWEEP_H
+
+#include "Command.h"
+
+/**
+ * @brief This class is used to fetch the data of a stored frequency sweep again without re-measuring it.
+ * All or a part of a sweep can be fetched, decimated and converted to different views, or only a summary of it.
+ */
+class FetchSweep : public Command
+{
+public:
+    /**
+     * @brief This function prints the stored sweep data.
+     * @param input_line The input line from the serial monitor. The syntax is g<sweep id>,<first point>,<last point>,<decimation><view>, gs<sweep id> or gl.
+     */
+    void execute(String input_line) override;
+    void printResult() override;
+    void printHelp() override;
+
+private:
+    void printPoints(int32_t id, uint16_t first_point, uint16_t last_point, uint16_t decimation, char view);
+    void printSummary(int32_t id);
+    void printList();
+    String result;
+};
+
+#endif
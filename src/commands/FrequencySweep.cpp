@@ -16,7 +16,24 @@ void FrequencySweep::execute(String input_line)
     uint32_t stopFreq = input_line.substring(stopFreqIndex, freqStepIndex - 1).toInt();
     uint32_t freqStep = input_line.substring(freqStepIndex).toInt(); // If no second parameter is provided, substring() goes to the end of the string
 
-    frequencySweep(startFreq, stopFreq, freqStep, true, 8);
+    // A step of 0 never reaches the stop frequency and a stop below the start would wrap around
+    if (freqStep == 0 || stopFreq < startFreq)
+    {
+        printError("Invalid frequency sweep, the step must be positive and the stop frequency not below the start frequency");
+        return;
+    }
+
+    // A trailing c requests the compact delta encoded format
+    boolean compact = input_line.endsWith("c");
+
+    int32_t sweep_id = frequencySweep(startFreq, stopFreq, freqStep, true, 8, compact);
+
+    // All points were sent, but the sweep store only keeps the first MAX_SWEEP_POINTS, so fetching the sweep later returns less
+    uint32_t points = (stopFreq - startFreq) / freqStep + 1;
+    if (sweep_id != -1 && points > MAX_SWEEP_POINTS)
+        printError("Sweep has " + String(points) + " points, only the first " + String(MAX_SWEEP_POINTS) + " are stored with id " + String(sweep_id));
+    else
+        printInfo("Stored sweep with id " + String(sweep_id));
 }
 
 void FrequencySweep::printResult()
@@ -31,4 +48,8 @@ void FrequencySweep::printHelp()
     Serial.println("Syntax: f<start frequency>f<stop frequency>f<frequency step>");
     Serial.println("Example: f100000000f200000000f50000");
     Serial.println("This will sweep the frequency from 100 MHz to 200 MHz with a step of 50 kHz");
+    Serial.println("Syntax: f<start frequency>f<stop frequency>f<frequency step>c");
+    Serial.println("Example: f100000000f200000000f50000c");
+    Serial.println("This will perform the same sweep but send the data in the compact delta encoded format");
+    Serial.println("Every sweep is sent completely, but only its first " + String(MAX_SWEEP_POINTS) + " points are stored for the fetch sweep command");
 }
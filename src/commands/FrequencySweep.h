@@ -10,7 +10,7 @@ class FrequencySweep : public Command {
 public:
     /**
      * @brief This function performs a frequency sweep
-     * @param input_line The input line from the serial monitor. The syntax is f<start frequency>f<stop frequency>f<frequency step>.
+     * @param input_line The input line from the serial monitor. The syntax is f<start frequency>f<stop frequency>f<frequency step> with an optional trailing c for the compact data format.
     */
     void execute(String input_line) override;
     void printResult() override;
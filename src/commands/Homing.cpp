@@ -7,15 +7,14 @@ void Homing::execute(String input_line)
     // Move the steppers to their home position
     tuner.STEPPER.setCurrentPosition(homeStepper(tuner));
     matcher.STEPPER.setCurrentPosition(homeStepper(matcher));
+    homed = true;
 
     // Now move the stepper a little bit away from the home position
     uint32_t REST_POSITION = 10000;
 
     tuner.STEPPER.moveTo(REST_POSITION);
-    tuner.STEPPER.runToPosition();
-
     matcher.STEPPER.moveTo(REST_POSITION);
-    matcher.STEPPER.runToPosition();
+    runSteppersToPositions();
 }
 
 void Homing::printResult()
@@ -18,14 +18,14 @@ void MoveStepper::execute(String input_line)
     {
         uint32_t matching_position = matcher.STEPPER.currentPosition();
         matcher.STEPPER.move(steps + backlash);
-        matcher.STEPPER.runToPosition();
+        runStepperToPosition(matcher);
         matcher.STEPPER.setCurrentPosition(matching_position + steps);
     }
     else if (stepper == TUNING_STEPPER)
     {
         uint32_t tuning_position = tuner.STEPPER.currentPosition();
         tuner.STEPPER.move(steps + backlash);
-        tuner.STEPPER.runToPosition();
+        runStepperToPosition(tuner);
         tuner.STEPPER.setCurrentPosition(tuning_position + steps);
     }
     else
@@ -1,3 +1,5 @@
+#include <vector>
+
 #include "Utilities.h"
 #include "PositionSweep.h"
 
@@ -44,24 +46,78 @@ void PositionSweep::execute(String input_line)
     printInfo("Tuning and Matching to target frequency in MHz (automatic mode):");
 
     // Perform the  position sweep
-    sweepPositions(tuning_range, tuning_step, tuning_backlash, matching_range, matching_step, matching_backlash);
+    // A trailing r selects the multi-resolution sweep which starts coarse and refines around the best position
+    // A trailing c selects the continuous sweep which measures while the matcher moves
+    if (input_line.endsWith("r"))
+        multiResolutionSweep(tuning_range, tuning_step, tuning_backlash, matching_range, matching_step, matching_backlash);
+    else if (input_line.endsWith("c"))
+        continuousSweep(tuner.STEPPER.currentPosition(), tuning_range, tuning_step, tuning_backlash, matcher.STEPPER.currentPosition(), matching_range, matching_step, matching_backlash);
+    else
+        sweepPositions(tuner.STEPPER.currentPosition(), tuning_range, tuning_step, tuning_backlash, matcher.STEPPER.currentPosition(), matching_range, matching_step, matching_backlash);
+
+    // Finally we set the found positions, both steppers move at the same time
+    int32_t tuning_compensation = backlash_compensation_for(tuner, tuning_position, tuning_backlash);
+    int32_t matching_compensation = backlash_compensation_for(matcher, matching_position, matching_backlash);
+    tuner.STEPPER.moveTo(tuning_position + tuning_compensation);
+    matcher.STEPPER.moveTo(matching_position + matching_compensation);
+    runSteppersToPositions();
+    tuner.STEPPER.setCurrentPosition(tuning_position);
+    matcher.STEPPER.setCurrentPosition(matching_position);
+
+}
+
+void PositionSweep::multiResolutionSweep(uint32_t tuning_range, uint32_t tuning_step, uint32_t tuning_backlash, uint32_t matching_range, uint32_t matching_step, uint32_t matching_backlash)
+{
+    // Number of positions per axis for the first coarse sweep
+    uint32_t COARSE_POSITIONS = 8;
+
+    if (tuning_step == 0 || matching_step == 0)
+    {
+        printError("Step size for multi-resolution position sweep must not be zero.");
+        return;
+    }
+
+    // The coarse step sizes are the requested step sizes times a power of two, so halving them ends exactly at the requested step sizes
+    uint32_t c_tuning_step = tuning_step;
+    while (2 * tuning_range / c_tuning_step > COARSE_POSITIONS)
+        c_tuning_step *= 2;
 
-    // Finally we set the found positions
-    absolute_move_backlashcorrected(tuner, tuning_position, tuning_backlash);
-    absolute_move_backlashcorrected(matcher, matching_position, matching_backlash);
+    uint32_t c_matching_step = matching_step;
+    while (2 * matching_range / c_matching_step > COARSE_POSITIONS)
+        c_matching_step *= 2;
 
+    uint32_t tuning_center = tuner.STEPPER.currentPosition();
+    uint32_t matching_center = matcher.STEPPER.currentPosition();
+    uint32_t c_tuning_range = tuning_range;
+    uint32_t c_matching_range = matching_range;
+
+    while (true)
+    {
+        printInfo("Position sweep with tuning step " + String(c_tuning_step) + " and matching step " + String(c_matching_step));
+        sweepPositions(tuning_center, c_tuning_range, c_tuning_step, tuning_backlash, matching_center, c_matching_range, c_matching_step, matching_backlash);
+
+        if ((c_tuning_step == tuning_step) && (c_matching_step == matching_step))
+            break;
+
+        // The next sweep covers the cells next to the best position with half the step size
+        tuning_center = tuning_position;
+        matching_center = matching_position;
+        c_tuning_range = c_tuning_step;
+        c_matching_range = c_matching_step;
+        c_tuning_step = max(c_tuning_step / 2, tuning_step);
+        c_matching_step = max(c_matching_step / 2, matching_step);
+    }
 }
 
-void PositionSweep::sweepPositions(uint32_t tuning_range, uint32_t tuning_step, uint32_t tuning_backlash, uint32_t matching_range, uint32_t matching_step, uint32_t matching_backlash)
+void PositionSweep::sweepPositions(uint32_t tuning_center, uint32_t tuning_range, uint32_t tuning_step, uint32_t tuning_backlash, uint32_t matching_center, uint32_t matching_range, uint32_t matching_step, uint32_t matching_backlash)
 {
     int AVERAGES = 4;
     // We want to maximize the reflection value, so we start with zero
     float_t minimum_reflection = 0.0;
 
-    // First we get the current tuning position
-    uint32_t start_tuning_position = tuner.STEPPER.currentPosition();
-    // Then we get the current matching position
-    uint32_t start_matching_position = matcher.STEPPER.currentPosition();
+    // The sweep is centered around the given tuning and matching positions
+    uint32_t start_tuning_position = tuning_center;
+    uint32_t start_matching_position = matching_center;
 
     uint32_t minimum_tuning_position = start_tuning_position - tuning_range;
     // Maximum tuning position
@@ -72,30 +128,158 @@ void PositionSweep::sweepPositions(uint32_t tuning_range, uint32_t tuning_step,
     // Maximum matching position
     uint32_t maximum_matching_position = start_matching_position + matching_range;
 
+    if (tuning_step == 0 || matching_step == 0)
+    {
+        printError("Step size for position sweep must not be zero.");
+        return;
+    }
+
+    uint32_t tuning_positions = (maximum_tuning_position - minimum_tuning_position) / tuning_step + 1;
+    uint32_t matching_positions = (maximum_matching_position - minimum_matching_position) / matching_step + 1;
+    uint32_t best_row = 0;
+    uint32_t best_column = 0;
+
     // The variables here are absolute positions
-    for (uint32_t c_tuning_position = minimum_tuning_position; c_tuning_position <= maximum_tuning_position; c_tuning_position += tuning_step)
+    for (uint32_t row = 0; row < tuning_positions; row++)
     {
+        uint32_t c_tuning_position = minimum_tuning_position + row * tuning_step;
         int backlash_compensation = absolute_move_backlashcorrected(tuner, c_tuning_position, tuning_backlash);
-        for (uint32_t c_matching_position = minimum_matching_position; c_matching_position <= maximum_matching_position; c_matching_position += matching_step)
+
+        // Every second row is swept backwards so the matcher does not have to return to the start of the row
+        for (uint32_t i = 0; i < matching_positions; i++)
         {
+            uint32_t column = (row % 2 == 0) ? i : matching_positions - 1 - i;
+            uint32_t c_matching_position = minimum_matching_position + column * matching_step;
+
             // Set the tuning and matching voltage
             int backlash_compensation = absolute_move_backlashcorrected(matcher, c_matching_position, matching_backlash);
+            scheduler.yield();
 
             // Measure the reflection at the given frequency
             int reflection = readReflection(AVERAGES);
 
             // If the reflection is lower than the current minimum, we have found a new minimum
-            if (reflection > minimum_reflection)
+            // On equal reflection the lower matching position of the row wins, so the result is the same as for a row by row sweep
+            if ((reflection > minimum_reflection) || ((reflection == minimum_reflection) && (row == best_row) && (column < best_column)))
             {
                 minimum_reflection = reflection;
                 tuning_position = c_tuning_position;
                 matching_position = c_matching_position;
+                best_row = row;
+                best_column = column;
             }
         }
     }
 }
 
-int PositionSweep::absolute_move_backlashcorrected(Stepper stepper, uint32_t position, int32_t backlash)
+void PositionSweep::continuousSweep(uint32_t tuning_center, uint32_t tuning_range, uint32_t tuning_step, uint32_t tuning_backlash, uint32_t matching_center, uint32_t matching_range, uint32_t matching_step, uint32_t matching_backlash)
+{
+    if (tuning_step == 0 || matching_step == 0)
+    {
+        printError("Step size for continuous position sweep must not be zero.");
+        return;
+    }
+
+    uint32_t minimum_tuning_position = tuning_center - tuning_range;
+    uint32_t minimum_matching_position = matching_center - matching_range;
+    uint32_t tuning_positions = 2 * tuning_range / tuning_step + 1;
+    uint32_t matching_positions = 2 * matching_range / matching_step + 1;
+
+    // Without a step generator the matcher stops for the readings, they are taken every sample_distance steps and averaged per matching step
+    long sample_distance = matching_step / CONTINUOUS_SAMPLES_PER_STEP;
+    if (sample_distance == 0)
+        sample_distance = 1;
+    float maximum_reflection = 0.0;
+
+    std::vector<long> reflection_sums;
+    std::vector<uint16_t> sample_counts;
+
+    for (uint32_t row = 0; row < tuning_positions; row++)
+    {
+        uint32_t c_tuning_position = minimum_tuning_position + row * tuning_step;
+        absolute_move_backlashcorrected(tuner, c_tuning_position, tuning_backlash);
+
+        // Every second row is scanned backwards, the matcher is already at the start of the row
+        int direction = (row % 2 == 0) ? 1 : -1;
+        long row_start = minimum_matching_position + ((row % 2 == 0) ? 0 : 2 * matching_range);
+        long row_end = minimum_matching_position + ((row % 2 == 0) ? 2 * matching_range : 0);
+        absolute_move_backlashcorrected(matcher, row_start, matching_backlash);
+
+        // The slack is taken up before the scan, otherwise the first samples of a reversed row would not belong to their positions
+        if (matching_last_direction != direction)
+        {
+            matcher.STEPPER.moveTo(row_start + direction * (long)matching_backlash);
+            runStepperToPosition(matcher);
+            matcher.STEPPER.setCurrentPosition(row_start);
+            matching_last_direction = direction;
+        }
+
+        reflection_sums.assign(matching_positions, 0);
+        sample_counts.assign(matching_positions, 0);
+
+        // The matcher runs at a constant speed without ramps. With a step generator it keeps moving and the readings are taken back to back.
+        // AccelStepper cannot step during a reading, so without a generator this falls back to a fine stepwise sweep
+        StepGenerator *generator = matcher.GENERATOR;
+        matcher.STEPPER.moveTo(row_end);
+        if (generator != nullptr)
+            motion.moveAtSpeed(matcher, row_end, CONTINUOUS_SPEED);
+        else
+            matcher.STEPPER.setSpeed(direction * CONTINUOUS_SPEED);
+
+        long sample_position = row_start;
+        boolean finished = false;
+        while (!finished)
+        {
+            float position;
+            int reflection;
+            if (generator != nullptr)
+            {
+                // The reading belongs to the position in the middle of the measurement
+                long position_before = generator->currentPosition();
+                reflection = readReflection(1);
+                position = (position_before + generator->currentPosition()) / 2.0;
+                finished = motion.isIdle();
+            }
+            else
+            {
+                while (matcher.STEPPER.currentPosition() != sample_position)
+                {
+                    matcher.STEPPER.runSpeed();
+                    scheduler.yield();
+                }
+                reflection = readReflection(1);
+                position = sample_position;
+                finished = sample_position == row_end;
+                sample_position = (direction > 0) ? min(sample_position + sample_distance, row_end) : max(sample_position - sample_distance, row_end);
+            }
+
+            long column = lround((position - minimum_matching_position) / matching_step);
+            if (column >= 0 && column < (long)matching_positions)
+            {
+                reflection_sums[column] += reflection;
+                sample_counts[column]++;
+            }
+            scheduler.yield();
+        }
+        motion.waitIdle();
+
+        for (uint32_t column = 0; column < matching_positions; column++)
+        {
+            if (sample_counts[column] == 0)
+                continue;
+
+            float reflection = (float)reflection_sums[column] / sample_counts[column];
+            if (reflection > maximum_reflection)
+            {
+                maximum_reflection = reflection;
+                tuning_position = c_tuning_position;
+                matching_position = minimum_matching_position + column * matching_step;
+            }
+        }
+    }
+}
+
+int PositionSweep::backlash_compensation_for(Stepper stepper, uint32_t position, int32_t backlash)
 {
     uint32_t current_position;
     // First we calculate the direction of the movement
@@ -139,25 +323,35 @@ int PositionSweep::absolute_move_backlashcorrected(Stepper stepper, uint32_t pos
         backlash_compensation = backlash * direction_to_move;
     }
 
-    // Now we move the stepper motor
     // And we set the last direction
     // This done here like that because I don't want to use pointers
     if (stepper_type == "Tuner")
-    {
         tuning_last_direction = direction_to_move;
+    else if (stepper_type == "Matcher")
+        matching_last_direction = direction_to_move;
+
+    return backlash_compensation;
+}
+
+int PositionSweep::absolute_move_backlashcorrected(Stepper stepper, uint32_t position, int32_t backlash)
+{
+    int32_t backlash_compensation = backlash_compensation_for(stepper, position, backlash);
+
+    // Now we move the stepper motor
+    if (stepper.TYPE == "Tuner")
+    {
         tuner.STEPPER.moveTo(position + backlash_compensation);
-        tuner.STEPPER.runToPosition();
+        runStepperToPosition(tuner);
         tuner.STEPPER.setCurrentPosition(position);
     }
-    else if (stepper_type == "Matcher")
+    else if (stepper.TYPE == "Matcher")
     {
-        matching_last_direction = direction_to_move;
         matcher.STEPPER.moveTo(position + backlash_compensation);
-        matcher.STEPPER.runToPosition();
+        runStepperToPosition(matcher);
+        matcher.STEPPER.setCurrentPosition(position);
     }
 
     return backlash_compensation;
-
 }
 
 void PositionSweep::printResult()
@@ -178,4 +372,10 @@ void PositionSweep::printHelp()
     Serial.println("Syntax: p<frequency in MHz>t<range>,<step size>,<backlash>m<range>,<step size>,<backlash>");
     Serial.println("Example: p100t100,20,1m100,20,1");
     Serial.println("This will perform a position sweep around 100MHz with a tuning range of 100 steps, a tuning step size of 20 step and a tuning backlash of 1 step. The same parameters are used for the matching stepper motor.");
+    Serial.println("Syntax: p<frequency in MHz>t<range>,<step size>,<backlash>m<range>,<step size>,<backlash>r");
+    Serial.println("Example: p100t100,5,1m100,5,1r");
+    Serial.println("This will start with a coarse sweep over the same range and then refine around the best position until the step size is 5 steps.");
+    Serial.println("Syntax: p<frequency in MHz>t<range>,<step size>,<backlash>m<range>,<step size>,<backlash>c");
+    Serial.println("Example: p100t100,20,1m100,20,1c");
+    Serial.println("This will move the matcher through each row at a constant speed and measure while it moves instead of stopping at every position.");
 }
\ No newline at end of file
@@ -3,6 +3,11 @@
 
 #include "Command.h"
 
+// Speed of the matcher in steps/s during a continuous sweep, slow enough to start and stop without ramps
+#define CONTINUOUS_SPEED 2000
+// Readings per matching step during a continuous sweep without a step generator, with one the readings are taken back to back
+#define CONTINUOUS_SAMPLES_PER_STEP 4U
+
 /**
  * @brief This class is used to perform a position sweep. This means the return loss at a given frequency will be measured and the tuning and matching positions with the lowest return loss will be found.
  */
@@ -14,7 +19,10 @@ public:
     void printHelp() override;
 
 private:
-    void sweepPositions(uint32_t tuning_range, uint32_t tuning_step, uint32_t tuning_backlash, uint32_t matching_range, uint32_t matching_step, uint32_t matching_backlash);
+    void sweepPositions(uint32_t tuning_center, uint32_t tuning_range, uint32_t tuning_step, uint32_t tuning_backlash, uint32_t matching_center, uint32_t matching_range, uint32_t matching_step, uint32_t matching_backlash);
+    void continuousSweep(uint32_t tuning_center, uint32_t tuning_range, uint32_t tuning_step, uint32_t tuning_backlash, uint32_t matching_center, uint32_t matching_range, uint32_t matching_step, uint32_t matching_backlash);
+    void multiResolutionSweep(uint32_t tuning_range, uint32_t tuning_step, uint32_t tuning_backlash, uint32_t matching_range, uint32_t matching_step, uint32_t matching_backlash);
+    int backlash_compensation_for(Stepper stepper, uint32_t position, int32_t backlash);
     int absolute_move_backlashcorrected(Stepper stepper, uint32_t position, int32_t backlash);
     uint32_t tuning_position;
     uint32_t matching_position;
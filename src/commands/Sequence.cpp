@@ -0,0 +1,162 @@
+#include "Utilities.h"
+#include "Sequence.h"
+
+#define ADD_LINE '+'
+#define SET_FREQUENCIES 'f'
+#define RUN_SEQUENCE 'r'
+#define LIST_SEQUENCE 'l'
+#define CLEAR_SEQUENCE 'c'
+
+// Constructor
+Sequence::Sequence(CommandManager &command_manager) : command_manager(command_manager)
+{
+}
+
+void Sequence::execute(String input_line)
+{
+    // Command format is q<action><arguments>
+    char action = input_line[1];
+    String arguments = input_line.substring(2);
+    failed = false;
+
+    if (action == ADD_LINE)
+        addLine(arguments);
+    else if (action == SET_FREQUENCIES)
+        setFrequencies(arguments);
+    else if (action == RUN_SEQUENCE)
+        run();
+    else if (action == LIST_SEQUENCE)
+    {
+        for (int i = 0; i < lines.size(); i++)
+            printInfo(String(i) + ": " + lines[i]);
+        result = "Sequence has " + String(lines.size()) + " lines";
+    }
+    else if (action == CLEAR_SEQUENCE)
+    {
+        lines.clear();
+        frequencies.clear();
+        result = "Sequence cleared";
+    }
+    else
+    {
+        result = "Invalid sequence action";
+        failed = true;
+    }
+}
+
+void Sequence::addLine(String command_line)
+{
+    command_line.trim();
+
+    failed = true;
+    if (lines.size() >= MAX_SEQUENCE_LINES)
+        result = "Sequence is full";
+    // A sequence must not start another sequence
+    else if (command_line.length() == 0 || command_line[0] == 'q')
+        result = "Invalid command line for sequence";
+    // A baud rate switch waits for the PC to answer at the new rate, which it can not do while the sequence runs
+    else if (command_line[0] == 'b')
+        result = "Baud rate switch is not allowed in a sequence";
+    else if (!command_manager.hasCommand(command_line[0]))
+        result = "Unknown command in sequence";
+    else
+    {
+        lines.push_back(command_line);
+        result = "Added line " + String(lines.size() - 1);
+        failed = false;
+    }
+}
+
+void Sequence::setFrequencies(String frequency_list)
+{
+    // Format is <frequency in MHz>,<frequency in MHz>,...
+    frequencies.clear();
+
+    while (frequency_list.length() > 0)
+    {
+        int delimiter_index = frequency_list.indexOf(',');
+        String frequency = (delimiter_index == -1) ? frequency_list : frequency_list.substring(0, delimiter_index);
+
+        if (validateInput(frequency.toFloat()) == 0)
+        {
+            frequencies.clear();
+            result = "Invalid frequency in sequence frequency list";
+            failed = true;
+            return;
+        }
+        if (frequencies.size() == MAX_SEQUENCE_FREQUENCIES)
+        {
+            frequencies.clear();
+            result = "Too many frequencies, the sequence can loop over at most " + String(MAX_SEQUENCE_FREQUENCIES);
+            failed = true;
+            return;
+        }
+        // Parsed in double precision so $h is the exact frequency in Hz
+        frequencies.push_back(lround(frequency.toDouble() * 1000000.0));
+
+        if (delimiter_index == -1)
+            break;
+        frequency_list = frequency_list.substring(delimiter_index + 1);
+    }
+
+    result = "Sequence loops over " + String(frequencies.size()) + " frequencies";
+}
+
+void Sequence::run()
+{
+    // Without a frequency list the sequence is run once and $f and $h are not replaced
+    int iterations = frequencies.empty() ? 1 : frequencies.size();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        String frequency_MHz = frequencies.empty() ? String("") : String(frequencies[i] / 1000000.0, 4);
+        String frequency_Hz = frequencies.empty() ? String("") : String(frequencies[i]);
+        if (!frequencies.empty())
+            printInfo("Sequence iteration " + String(i) + " at " + frequency_MHz + " MHz");
+
+        for (String command_line : lines)
+        {
+            if (!frequencies.empty())
+            {
+                command_line.replace("$f", frequency_MHz);
+                command_line.replace("$h", frequency_Hz);
+            }
+
+            // Every command confirms and prints its result just like when it is sent by the PC
+            char command = command_line.charAt(0);
+            command_manager.executeCommand(command, command_line);
+            command_manager.printCommandResult(command);
+        }
+    }
+
+    result = "Sequence finished after " + String(iterations) + " iterations";
+}
+
+void Sequence::printResult()
+{
+    if (failed)
+        printError(result);
+    else
+        printInfo(result);
+    // This tells the PC that the sequence command is finished
+    Serial.println("q");
+}
+
+void Sequence::printHelp()
+{
+    Serial.println("Sequence command");
+    Serial.println("Syntax: q+<command line>");
+    Serial.println("Example: q+s$fo1.2o2.3");
+    Serial.println("This will add a preset voltage sweep at the current loop frequency to the sequence");
+    Serial.println("Sequences and baud rate switches can not be added");
+    Serial.println("Syntax: qf<frequency in MHz>,<frequency in MHz>,...");
+    Serial.println("Example: qf83.1,83.2,83.3");
+    Serial.println("This will loop the sequence over 83.1, 83.2 and 83.3 MHz. Every $f is replaced by the current frequency in MHz with 4 decimals, every $h by the current frequency in Hz");
+    Serial.println("Use $f for the commands that take MHz like d, r and s, and $h for the commands that take Hz like f");
+    Serial.println("Syntax: qr");
+    Serial.println("This will run the sequence and print the results of every command");
+    Serial.println("Syntax: ql");
+    Serial.println("This will list the command lines of the sequence");
+    Serial.println("Syntax: qc");
+    Serial.println("This will clear the sequence and the frequency list");
+}
@@ -0,0 +1,40 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <vector>
+#include "Command.h"
+#include "CommandManager.h"
+
+// Maximum number of command lines a sequence can hold
+#define MAX_SEQUENCE_LINES 32
+// Maximum number of frequencies the sequence can loop over
+#define MAX_SEQUENCE_FREQUENCIES 512
+
+/**
+ * @brief This class is used to store a sequence of commands in RAM and run it without the PC sending every single command.
+ * The sequence can loop over a list of frequencies, every $f in a command line is replaced by the current frequency in MHz and every $h by the frequency in Hz.
+ */
+class Sequence : public Command
+{
+public:
+    Sequence(CommandManager &command_manager);
+    /**
+     * @brief This function edits or runs the stored sequence.
+     * @param input_line The input line from the serial monitor. The syntax is q<action><arguments>, see printHelp for the actions.
+     */
+    void execute(String input_line) override;
+    void printResult() override;
+    void printHelp() override;
+
+private:
+    void addLine(String command_line);
+    void setFrequencies(String frequency_list);
+    void run();
+    CommandManager &command_manager;
+    std::vector<String> lines;
+    std::vector<uint32_t> frequencies; // Hz
+    String result;
+    boolean failed = false; // true if result is an error
+};
+
+#endif
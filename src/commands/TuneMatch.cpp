@@ -3,23 +3,430 @@
 
 void TuneMatch::execute(String input_line)
 {
+  // Command format is d<target frequency in MHz><optional strategy>
   float target_frequency_MHz = input_line.substring(1).toFloat();
   uint32_t target_frequency = validateInput(target_frequency_MHz);
   if (target_frequency == 0)
     return;
 
+  char strategy = input_line[input_line.length() - 1];
+
+  printInfo("Tuning and Matching to target frequency in MHz (automatic mode):");
+  printInfo(target_frequency_MHz);
+
+  tuneTo(target_frequency, strategy);
+}
+
+uint32_t TuneMatch::tuneTo(uint32_t target_frequency, char strategy)
+{
+  // The searches of the strategies overlap, readings at positions that are visited again are taken from the cache
+  measurementCache.beginSession();
+  uint32_t frequency = tuneSession(target_frequency, strategy);
+  printInfo(measurementCache.endSession());
+
+  return frequency;
+}
+
+uint32_t TuneMatch::tuneSession(uint32_t target_frequency, char strategy)
+{
   uint32_t startf = 35000000U;
   uint32_t stopf = 110000000U;
   uint32_t stepf = 100000U;
-  printInfo("Tuning and Matching to target frequency in MHz (automatic mode):");
-  printInfo(target_frequency_MHz);
 
-  uint32_t resonance_frequency = automaticTM(target_frequency, startf, stopf, stepf);
+  resonance_frequency = 0;
+  resonance_reflection = 0;
+  resonance_uncertainty = 0;
+
+  if (strategy == STRATEGY_TRACKING)
+    resonance_frequency = trackingTM(target_frequency, stepf);
+
+  // Starting from learned positions the resonance is already close to the target, so only a small window has to be searched
+  int learned_reflection = 0;
+  if (resonance_frequency == 0 && moveToLearnedPositions(target_frequency, &learned_reflection))
+  {
+    resonance_frequency = refineLearnedPositions(target_frequency, learned_reflection, stepf);
+    if (resonance_frequency == 0)
+      resonance_frequency = tuneMatch(strategy, target_frequency, target_frequency - CALIBRATION_SEED_WINDOW, target_frequency + CALIBRATION_SEED_WINDOW, stepf);
+  }
+
+  if (resonance_frequency == 0)
+    resonance_frequency = tuneMatch(strategy, target_frequency, startf, stopf, stepf);
+
+  if (resonance_frequency == 0)
+  {
+    tracking_valid = false;
+    return 0;
+  }
+
+  // The last scan around the reached resonance also tells how well its frequency is known
+  int32_t measured_frequency = findCurrentResonanceFrequency(resonance_frequency - stepf, resonance_frequency + stepf, stepf / 2, false, &resonance_uncertainty);
+  if (measured_frequency != 0)
+    resonance_frequency = measured_frequency;
+
+  setFrequency(resonance_frequency);
+  delay(10);
+  resonance_reflection = readReflection(16);
+
+  learnPositions(target_frequency, resonance_reflection);
+  storeTracking(resonance_reflection);
+
+  return resonance_frequency;
+}
+
+int TuneMatch::getReflection()
+{
+  return resonance_reflection;
+}
+
+float TuneMatch::getUncertainty()
+{
+  return resonance_uncertainty;
+}
+
+uint32_t TuneMatch::tuneMatch(char strategy, uint32_t target_frequency, uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step)
+{
+  if (strategy == STRATEGY_JOINT)
+    return jointTM(target_frequency, start_frequency, stop_frequency, frequency_step);
+  else if (strategy == STRATEGY_MODEL)
+    return modelTM(target_frequency, start_frequency, stop_frequency, frequency_step);
+  else
+    return automaticTM(target_frequency, start_frequency, stop_frequency, frequency_step);
+}
+
+boolean TuneMatch::moveToLearnedPositions(uint32_t target_frequency, int *learned_reflection)
+{
+  // Without homing the step counts do not belong to the learned positions
+  if (!homed)
+    return false;
+
+  int32_t positions[CALIBRATION_VALUES];
+  if (positionMap.lookup(target_frequency, positions, learned_reflection) > CALIBRATION_SEED_DISTANCE)
+    return false;
+
+  printInfo("Starting from learned positions tuner " + String(positions[0]) + " matcher " + String(positions[1]));
+  moveSteppersBacklashCorrected(positions[0], positions[1]);
+  // The resonance is searched right away, the frequency is not close to it yet so the settling cannot be measured
+  settleModel.waitUntilSettled();
+
+  return true;
+}
+
+uint32_t TuneMatch::refineLearnedPositions(uint32_t target_frequency, int learned_reflection, uint32_t frequency_step)
+{
+  // Only the tuner is corrected, a full search is only done if the matching turns out worse than learned
+  uint32_t resonance_frequency = findResonanceAdaptive(target_frequency - CALIBRATION_SEED_WINDOW, target_frequency + CALIBRATION_SEED_WINDOW, frequency_step).frequency;
+  if (resonance_frequency == 0)
+    return 0;
+
+  uint32_t deviation = (resonance_frequency > target_frequency) ? resonance_frequency - target_frequency : target_frequency - resonance_frequency;
+  if (deviation > frequency_step / 4)
+    resonance_frequency = bruteforceResonance(target_frequency, resonance_frequency);
+
+  setFrequency(resonance_frequency);
+  delay(10);
+  int reflection = readReflection(16);
+  if (reflection < learned_reflection - CALIBRATION_REFLECTION_MARGIN)
+  {
+    printInfo("Matching is worse than learned, searching again");
+    return 0;
+  }
+
+  return resonance_frequency;
+}
+
+void TuneMatch::learnPositions(uint32_t target_frequency, int reflection)
+{
+  if (!homed)
+    return;
+
+  uint32_t deviation = (resonance_frequency > target_frequency) ? resonance_frequency - target_frequency : target_frequency - resonance_frequency;
+  if (deviation > CALIBRATION_TOLERANCE)
+    return;
+
+  // The positions are learned for the frequency they actually resonate at
+  int32_t positions[CALIBRATION_VALUES] = {(int32_t)tuner.STEPPER.currentPosition(), (int32_t)matcher.STEPPER.currentPosition()};
+  positionMap.record(resonance_frequency, positions, reflection);
+}
+
+uint32_t TuneMatch::trackingTM(uint32_t target_frequency, uint32_t frequency_step)
+{
+  // The last solution is only a valid starting point if nothing has moved the steppers since
+  uint32_t distance = abs((int32_t)target_frequency - tracking_resonance);
+  if (!tracking_valid || distance > TRACKING_RANGE || tuner.STEPPER.currentPosition() != tracking_tuning_position || matcher.STEPPER.currentPosition() != tracking_matching_position)
+  {
+    printInfo("No tracking state for this target, tuning from scratch");
+    return 0;
+  }
+
+  int32_t RESONANCE_TOLERANCE = frequency_step / 4;
+  long MAXIMUM_STEPS = STEPS_PER_ROTATION;
+  int measurements = 0;
+
+  int32_t resonance = tracking_resonance;
+  for (int i = 0; i < TRACKING_ITERATIONS && tracking_slope != 0; i++)
+  {
+    int32_t delta_frequency = (int32_t)target_frequency - resonance;
+    if (abs(delta_frequency) <= RESONANCE_TOLERANCE)
+      break;
+
+    // The predicted move, the matcher follows the tuner like it did between the last solutions
+    long steps = constrain(lround(delta_frequency / tracking_slope), -MAXIMUM_STEPS, MAXIMUM_STEPS);
+    if (steps == 0)
+      break;
+
+    // A prediction beyond the travel cannot be reached from the last solution
+    long tuning_position = tuner.STEPPER.currentPosition() + steps;
+    long matching_position = matcher.STEPPER.currentPosition() + lround(steps * tracking_matching_ratio);
+    if (limitToTravel(tuning_position) != tuning_position || limitToTravel(matching_position) != matching_position)
+      return 0;
+
+    moveBacklashCorrected(tuner, tuning_position);
+    if (matching_position != matcher.STEPPER.currentPosition())
+      moveBacklashCorrected(matcher, matching_position);
+
+    resonance = measureResonanceNear(target_frequency, frequency_step);
+    measurements++;
+    if (resonance == 0)
+      return 0;
+  }
+
+  // Without a known slope or if the prediction did not converge the secant search takes over from here
+  if (abs((int32_t)target_frequency - resonance) > RESONANCE_TOLERANCE)
+  {
+    // A slope whose predictions do not converge is wrong, it is learned again from this step
+    if (measurements > 0)
+      tracking_slope = 0;
+    resonance = bruteforceResonance(target_frequency, resonance);
+  }
+  if (resonance == 0)
+    return 0;
+
+  setFrequency(resonance);
+  delay(10);
+  if (readReflection(16) < tracking_reflection - TRACKING_REFLECTION_MARGIN)
+  {
+    printInfo("Matching dropped, optimizing matching");
+    optimizeMatching(resonance);
+    resonance = measureResonanceNear(target_frequency, frequency_step);
+    if (resonance == 0)
+      return 0;
+    if (abs((int32_t)target_frequency - resonance) > RESONANCE_TOLERANCE)
+      resonance = bruteforceResonance(target_frequency, resonance);
+  }
+
+  // The slope and the matcher ratio are learned from the step between the last and this solution
+  long tuning_steps = tuner.STEPPER.currentPosition() - tracking_tuning_position;
+  if (abs(tuning_steps) >= TRACKING_MINIMUM_STEPS)
+  {
+    float slope = (resonance - tracking_resonance) / (float)tuning_steps;
+
+    // The resonance rises with the tuner position, a slope with the wrong sign or far off the last one is rather a measurement error than physics
+    if (slope > 0 && (tracking_slope == 0 || (slope / tracking_slope > 0.25 && slope / tracking_slope < 4)))
+    {
+      tracking_slope = slope;
+      tracking_matching_ratio = (matcher.STEPPER.currentPosition() - tracking_matching_position) / (float)tuning_steps;
+    }
+  }
+
+  printInfo("Tracked resonance after " + String(measurements) + " predicted moves");
+
+  return resonance;
+}
+
+int32_t TuneMatch::measureResonanceNear(uint32_t frequency, uint32_t frequency_step)
+{
+  // After a predicted move the resonance should be within a few steps of the target, so a short scan is enough
+  uint32_t step = frequency_step / 2;
+  uint32_t start_frequency = frequency - 2 * step;
+  if (measurementCache.isActive())
+    start_frequency -= start_frequency % step; // estimateResonance() scans on a grid of the step
+  uint32_t stop_frequency = start_frequency + 4 * step;
+  ResonanceEstimate estimate = estimateResonance(start_frequency, stop_frequency, step);
+
+  // A peak at the edge of the window means the resonance lies outside of it
+  if (estimate.frequency != 0 && estimate.frequency != (int32_t)start_frequency && estimate.frequency != (int32_t)stop_frequency)
+    return estimate.frequency;
+
+  return findResonanceAdaptive(frequency - CALIBRATION_SEED_WINDOW, frequency + CALIBRATION_SEED_WINDOW, step).frequency;
+}
+
+void TuneMatch::storeTracking(int reflection)
+{
+  tracking_valid = true;
+  tracking_resonance = resonance_frequency;
+  tracking_tuning_position = tuner.STEPPER.currentPosition();
+  tracking_matching_position = matcher.STEPPER.currentPosition();
+  tracking_reflection = reflection;
+}
+
+uint32_t TuneMatch::modelTM(uint32_t target_frequency, uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step)
+{
+  // Instead of stepping until the reflection improves, every move goes to where the fitted resonator model predicts the target
+  model_fits = 0;
+
+  uint32_t resonance_frequency = findResonanceAdaptive(start_frequency, stop_frequency, frequency_step).frequency;
+  if (resonance_frequency == 0)
+    return 0;
+
+  ResonatorModel model = fitModelAround(resonance_frequency, 0, frequency_step);
+  if (model.frequency == 0)
+    return 0;
+
+  // Matching shifts the resonance, so the tuner is corrected again afterwards
+  model = tuneWithModel(target_frequency, model, frequency_step);
+  if (model.frequency != 0)
+    model = matchWithModel(model, frequency_step);
+  if (model.frequency != 0)
+    model = tuneWithModel(target_frequency, model, frequency_step);
+  if (model.frequency == 0)
+    return 0;
+
+  printInfo("Model after " + String(model_fits) + " fits: loaded Q " + String(model.loaded_q, 1) + ", coupling " + String(model.coupling, 3) + ", residual " + String(model.residual, 1) + " mV");
+
+  return model.frequency;
+}
+
+ResonatorModel TuneMatch::fitModelAround(uint32_t center_frequency, float loaded_q, uint32_t frequency_step)
+{
+  // The sweep has to show the whole dip with some wings, its width follows from the last known bandwidth
+  uint32_t span = (loaded_q > 0) ? constrain((uint32_t)(MODEL_BANDWIDTHS * center_frequency / loaded_q), MODEL_MINIMUM_SPAN, MODEL_MAXIMUM_SPAN) : MODEL_MAXIMUM_SPAN / 2;
+
+  ResonatorModel model = {0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  for (int attempt = 0; attempt < 2 && span <= MODEL_MAXIMUM_SPAN; attempt++)
+  {
+    uint32_t step = max(span / MODEL_POINTS, frequency_step / 10);
+    model = measureResonatorModel(center_frequency - span / 2, center_frequency + span / 2, step);
+    model_fits++;
+
+    // Without the bandwidth inside the sweep the dip is cut off or the resonance has moved further than expected
+    if (model.loaded_q > 0)
+      return model;
+    if (model.frequency != 0)
+      center_frequency = model.frequency;
+    span *= 2;
+  }
+
+  return model;
+}
+
+ResonatorModel TuneMatch::tuneWithModel(uint32_t target_frequency, ResonatorModel model, uint32_t frequency_step)
+{
+  int32_t RESONANCE_TOLERANCE = frequency_step / 4;
+  long PROBE_STEPS = STEPS_PER_ROTATION / 20;
+  long MAXIMUM_STEPS = 2 * STEPS_PER_ROTATION;
+
+  // The slope is taken from the sensitivity matrix, which also learns it from the moves of the secant search
+  sensitivity.observe(tuner.STEPPER.currentPosition(), matcher.STEPPER.currentPosition(), model.frequency, 0);
+
+  for (int i = 0; i < MODEL_ITERATIONS; i++)
+  {
+    int32_t delta_frequency = (int32_t)target_frequency - model.frequency;
+    if (abs(delta_frequency) <= RESONANCE_TOLERANCE)
+      break;
+
+    // Positive steps raise the frequency, with a slope of the wrong sign a small probe move in the direction of the target measures it again
+    float tuning_slope = sensitivity.get(0, 0);
+    boolean predicted = tuning_slope > 0;
+    long steps = predicted ? predictTuningSteps(model, target_frequency, tuning_slope) : ((delta_frequency > 0) ? PROBE_STEPS : -PROBE_STEPS);
+    steps = constrain(steps, -MAXIMUM_STEPS, MAXIMUM_STEPS);
+    if (steps == 0)
+      break;
+
+    // A move beyond the travel fails like a fit without resonance
+    long tuning_position = tuner.STEPPER.currentPosition() + steps;
+    if (limitToTravel(tuning_position) != tuning_position)
+    {
+      sensitivity.forget();
+      model.frequency = 0;
+      return model;
+    }
+
+    uint32_t expected_frequency = predicted ? target_frequency : model.frequency;
+    moveBacklashCorrected(tuner, tuning_position);
+
+    model = fitModelAround(expected_frequency, model.loaded_q, frequency_step);
+    if (model.frequency == 0)
+    {
+      sensitivity.forget();
+      return model;
+    }
+    sensitivity.observe(tuner.STEPPER.currentPosition(), matcher.STEPPER.currentPosition(), model.frequency, 0);
+  }
+
+  return model;
+}
+
+ResonatorModel TuneMatch::matchWithModel(ResonatorModel model, uint32_t frequency_step)
+{
+  long PROBE_STEPS = STEPS_PER_ROTATION / 10;
+  long MAXIMUM_STEPS = STEPS_PER_ROTATION;
+
+  if (model.mismatch <= MODEL_MISMATCH_TOLERANCE)
+    return model;
+
+  int phase = 0;
+  int rotation = estimateMatchRotation(model.frequency, &phase);
+  if (rotation == 0)
+    rotation = getMatchRotation(model.frequency);
+
+  long position = matcher.STEPPER.currentPosition();
+  long best_position = position;
+  ResonatorModel best_model = model;
+
+  for (int i = 0; i < MODEL_ITERATIONS && model.mismatch > MODEL_MISMATCH_TOLERANCE; i++)
+  {
+    // The move goes to the predicted critical coupling, while the slope is unknown a fixed probe move is made
+    long steps = (model_mismatch_slope > 0) ? predictMatchingSteps(model, model_mismatch_slope, rotation) : rotation * PROBE_STEPS;
+    steps = constrain(steps, -MAXIMUM_STEPS, MAXIMUM_STEPS);
+    if (steps == 0 || limitToTravel(position + steps) != position + steps)
+      break;
+
+    moveBacklashCorrected(matcher, position + steps);
+    ResonatorModel moved_model = fitModelAround(model.frequency, model.loaded_q, frequency_step);
+    if (moved_model.frequency == 0)
+      break;
+
+    // The mismatch is V-shaped over the matcher position, the move either stayed on one side of critical coupling or crossed it.
+    // With a known slope the case that fits it better is taken, otherwise a worse mismatch means the move went past the optimum.
+    float same_side_slope = (model.mismatch - moved_model.mismatch) / abs(steps);
+    float crossed_slope = (model.mismatch + moved_model.mismatch) / abs(steps);
+    boolean crossed;
+    if (model_mismatch_slope > 0)
+      crossed = fabs(crossed_slope - model_mismatch_slope) < fabs(same_side_slope - model_mismatch_slope);
+    else
+      crossed = moved_model.mismatch >= model.mismatch;
+    if (same_side_slope <= 0)
+      crossed = true;
+
+    model_mismatch_slope = crossed ? crossed_slope : same_side_slope;
+    if (crossed)
+      rotation = -rotation;
+
+    position += steps;
+    model = moved_model;
+    if (model.mismatch < best_model.mismatch)
+    {
+      best_model = model;
+      best_position = position;
+    }
+  }
+
+  if (position != best_position)
+  {
+    moveBacklashCorrected(matcher, best_position);
+    model = fitModelAround(best_model.frequency, best_model.loaded_q, frequency_step);
+    if (model.frequency == 0)
+      model = best_model;
+  }
+
+  return model;
 }
 
 uint32_t TuneMatch::automaticTM(uint32_t target_frequency, uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step)
 {
-  uint32_t resonance_frequency = findCurrentResonanceFrequency(start_frequency, stop_frequency, frequency_step);
+  uint32_t resonance_frequency = findResonanceAdaptive(start_frequency, stop_frequency, frequency_step).frequency;
+  if (resonance_frequency == 0)
+    return 0;
 
   DEBUG_PRINT("Resonance Frequency before TM");
   DEBUG_PRINT(resonance_frequency);
@@ -35,10 +442,128 @@ uint32_t TuneMatch::automaticTM(uint32_t target_frequency, uint32_t start_freque
   return resonance_frequency;
 }
 
+uint32_t TuneMatch::jointTM(uint32_t target_frequency, uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step)
+{
+  // Tuner and matcher interact strongly, so instead of alternating between them we search both positions at once
+  // with a Hooke-Jeeves pattern search that maximizes the reflection value at the target frequency.
+  int MAXIMUM_EVALUATIONS = 150;
+  long MINIMUM_STEP = 4;
+  long steps[2] = {STEPS_PER_ROTATION / 20, STEPS_PER_ROTATION / 10}; // tuner, matcher
+
+  moves = 0;
+
+  // Far away from the target the reflection at the target frequency carries no information, so the resonance is brought close first
+  uint32_t resonance_frequency = findResonanceAdaptive(start_frequency, stop_frequency, frequency_step).frequency;
+  if (resonance_frequency == 0)
+    return 0;
+  resonance_frequency = bruteforceResonance(target_frequency, resonance_frequency);
+
+  setFrequency(target_frequency);
+
+  long base[2] = {tuner.STEPPER.currentPosition(), matcher.STEPPER.currentPosition()};
+  int base_reflection = measureJoint(base[0], base[1]);
+  int evaluations = 1;
+  int iterations = 0;
+
+  while ((steps[0] >= MINIMUM_STEP || steps[1] >= MINIMUM_STEP) && evaluations < MAXIMUM_EVALUATIONS)
+  {
+    iterations++;
+
+    // Exploratory moves around the base point
+    long point[2] = {base[0], base[1]};
+    int point_reflection = exploreJoint(point, base_reflection, steps, MINIMUM_STEP, &evaluations);
+
+    if (point_reflection <= base_reflection)
+    {
+      // No improvement, the step sizes are halved
+      steps[0] /= 2;
+      steps[1] /= 2;
+      continue;
+    }
+
+    // Pattern move: keep going in the direction that improved the reflection as long as it does.
+    // The pattern point is only accepted if the exploration around it beats the base point, otherwise the search returns to the base
+    while (evaluations < MAXIMUM_EVALUATIONS)
+    {
+      long pattern[2] = {2 * point[0] - base[0], 2 * point[1] - base[1]};
+      base[0] = point[0];
+      base[1] = point[1];
+      base_reflection = point_reflection;
+
+      int pattern_reflection = measureJoint(pattern[0], pattern[1]);
+      evaluations++;
+      pattern_reflection = exploreJoint(pattern, pattern_reflection, steps, MINIMUM_STEP, &evaluations);
+      if (pattern_reflection <= base_reflection)
+        break;
+
+      point[0] = pattern[0];
+      point[1] = pattern[1];
+      point_reflection = pattern_reflection;
+    }
+  }
+
+  measureJoint(base[0], base[1]);
+
+  printInfo("Joint search finished after " + String(iterations) + " iterations, " + String(evaluations) + " measurements and " + String(moves) + " moves");
+
+  resonance_frequency = findCurrentResonanceFrequency(target_frequency - 1000000U, target_frequency + 1000000U, frequency_step / 2);
+
+  return resonance_frequency;
+}
+
+int TuneMatch::exploreJoint(long point[2], int point_reflection, const long steps[2], long minimum_step, int *evaluations)
+{
+  // One axis after the other, the first direction that improves the reflection is kept
+  for (int axis = 0; axis < 2; axis++)
+  {
+    if (steps[axis] < minimum_step)
+      continue;
+
+    for (int direction = 1; direction >= -1; direction -= 2)
+    {
+      long candidate[2] = {point[0], point[1]};
+      candidate[axis] += direction * steps[axis];
+      int candidate_reflection = measureJoint(candidate[0], candidate[1]);
+      (*evaluations)++;
+
+      if (candidate_reflection > point_reflection)
+      {
+        point[axis] = candidate[axis];
+        point_reflection = candidate_reflection;
+        break;
+      }
+    }
+  }
+
+  return point_reflection;
+}
+
+int TuneMatch::measureJoint(long tuning_position, long matching_position)
+{
+  // A candidate beyond the travel is not moved to, its reflection of 0 never beats a measured point
+  if (limitToTravel(tuning_position) != tuning_position || limitToTravel(matching_position) != matching_position)
+    return 0;
+
+  // All positions are approached from the same direction so the measured reflection belongs to the position
+  // Both steppers move at once, a diagonal step of the search takes no longer than a single axis step.
+  // Moving back overshoots by the backlash first, that is a second move
+  if (tuning_position != tuner.STEPPER.currentPosition() || matching_position != matcher.STEPPER.currentPosition())
+  {
+    boolean back = tuning_position < tuner.STEPPER.currentPosition() || matching_position < matcher.STEPPER.currentPosition();
+    moveSteppersBacklashCorrected(tuning_position, matching_position);
+    moves += back ? 2 : 1;
+  }
+
+  // Right after a move the shafts still ring, the settling is measured until the model knows the distance
+  settleModel.settle();
+  return readReflection(16);
+}
+
 void TuneMatch::printResult()
 {
+  // Format is r<resonance frequency>u<uncertainty of the resonance frequency in Hz>
   Serial.print("r");
-  printInfo(resonance_frequency);
+  printInfo(String(resonance_frequency) + "u" + String(lround(resonance_uncertainty)));
 }
 
 void TuneMatch::printHelp()
@@ -47,4 +572,12 @@ void TuneMatch::printHelp()
   Serial.println("Syntax: d<target frequency in MHz>");
   Serial.println("Example: d100");
   Serial.println("This will tune and match to 100 MHz");
+  Serial.println("Syntax: d<target frequency in MHz><strategy>");
+  Serial.println("Example: d100j");
+  Serial.println("Possible strategies:");
+  Serial.println("a: alternate tuning and matching (default)");
+  Serial.println("j: joint pattern search over tuner and matcher position");
+  Serial.println("t: tracking, starts from the solution of the last target, use it for stepped frequency scans");
+  Serial.println("o: model, fits a resonator model and moves to the predicted tuner and matcher positions");
+  Serial.println("After homing the search starts from the positions learned for nearby frequencies");
 }
\ No newline at end of file
@@ -2,16 +2,99 @@
 #define TUNEMATCH_H
 
 #include "Command.h"
+#include "ResonatorModel.h"
+
+// Strategies for tuning and matching, selected by the last character of the command
+#define STRATEGY_ALTERNATING 'a' // alternates bruteforceResonance and optimizeMatching (default)
+#define STRATEGY_JOINT 'j'       // pattern search over tuner and matcher position at the same time
+#define STRATEGY_TRACKING 't'    // starts from the last solution, for stepped frequency scans
+#define STRATEGY_MODEL 'o'       // jumps to the positions predicted by the fitted resonator model
+
+// Targets up to this far from the last resonance are reached by tracking
+#define TRACKING_RANGE 2000000U // 2MHz
+// Predicted moves per target, the remaining deviation is corrected by bruteforceResonance
+#define TRACKING_ITERATIONS 3
+// Tuner moves shorter than this are too noisy to learn the slope from
+#define TRACKING_MINIMUM_STEPS 4
+// The matching is optimized again if the reflection drops by more than this compared to the last target
+#define TRACKING_REFLECTION_MARGIN 30 // mV, ~1dB
+
+// Predicted moves per axis of the model strategy
+#define MODEL_ITERATIONS 4
+// Number of sweep points per model fit
+#define MODEL_POINTS 40
+// The model sweep covers this many bandwidths, within these limits
+#define MODEL_BANDWIDTHS 6
+#define MODEL_MINIMUM_SPAN 1000000U // 1MHz
+#define MODEL_MAXIMUM_SPAN 8000000U // 8MHz
+// Matching is good enough below this mismatch, 0.2 corresponds to a return loss of 20dB
+#define MODEL_MISMATCH_TOLERANCE 0.2
+
+// Learned positions closer than this to the target are used as starting point
+#define CALIBRATION_SEED_DISTANCE 10000000U // 10MHz
+// Around the learned positions the resonance is only searched in this window around the target
+#define CALIBRATION_SEED_WINDOW 5000000U // 5MHz
+// The learned positions are accepted without a new search if the reflection is at most this much lower than learned
+#define CALIBRATION_REFLECTION_MARGIN 30 // mV, ~1dB
 
 class TuneMatch : public Command {
 public:
     void execute(String input_line) override;
     void printResult() override;
     void printHelp() override;
+
+    /**
+     * @brief This function tunes and matches to a target frequency, it is used by the 'd' command and by other commands that tune.
+     *
+     * @param target_frequency The target frequency in Hz
+     * @param strategy One of the STRATEGY_ characters
+     * @return uint32_t The resonance frequency that was reached, 0 if no resonance was found
+     */
+    uint32_t tuneTo(uint32_t target_frequency, char strategy);
+
+    /**
+     * @brief This function returns the reflection in millivolts at the resonance that was reached by the last tuneTo() call.
+     */
+    int getReflection();
+
+    /**
+     * @brief This function returns the standard deviation in Hz of the resonance frequency that was reached by the last tuneTo() call.
+     */
+    float getUncertainty();
 private:
+    uint32_t tuneSession(uint32_t target_frequency, char strategy);
     uint32_t automaticTM(uint32_t target_frequency, uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step);
+    uint32_t jointTM(uint32_t target_frequency, uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step);
+    int measureJoint(long tuning_position, long matching_position);
+    int exploreJoint(long point[2], int point_reflection, const long steps[2], long minimum_step, int *evaluations);
+    uint32_t tuneMatch(char strategy, uint32_t target_frequency, uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step);
+    boolean moveToLearnedPositions(uint32_t target_frequency, int *learned_reflection);
+    uint32_t refineLearnedPositions(uint32_t target_frequency, int learned_reflection, uint32_t frequency_step);
+    void learnPositions(uint32_t target_frequency, int reflection);
+    uint32_t trackingTM(uint32_t target_frequency, uint32_t frequency_step);
+    int32_t measureResonanceNear(uint32_t frequency, uint32_t frequency_step);
+    void storeTracking(int reflection);
+    uint32_t modelTM(uint32_t target_frequency, uint32_t start_frequency, uint32_t stop_frequency, uint32_t frequency_step);
+    ResonatorModel fitModelAround(uint32_t center_frequency, float loaded_q, uint32_t frequency_step);
+    ResonatorModel tuneWithModel(uint32_t target_frequency, ResonatorModel model, uint32_t frequency_step);
+    ResonatorModel matchWithModel(ResonatorModel model, uint32_t frequency_step);
     uint32_t resonance_frequency;
+    int resonance_reflection;
+    float resonance_uncertainty;
+    int moves;
+
+    // State of the tracking strategy, the solution of the last target
+    boolean tracking_valid = false;
+    int32_t tracking_resonance = 0;
+    long tracking_tuning_position = 0;
+    long tracking_matching_position = 0;
+    int tracking_reflection = 0;
+    float tracking_slope = 0;          // Hz per tuner step, 0 if not known yet
+    float tracking_matching_ratio = 0; // matcher steps per tuner step between neighbouring solutions
 
+    // Sensitivity of the resonator model to the matcher, learned by the model strategy. The tuner slope is taken from the sensitivity matrix
+    float model_mismatch_slope = 0; // mismatch change per matcher step, 0 if not known yet
+    int model_fits;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -80,6 +80,50 @@ void VoltageSweep::presetVoltages(uint32_t frequency, float_t tuning_voltage_pre
 
     adac.write_DAC(VM, matching_voltage);
     adac.write_DAC(VT, tuning_voltage);
+    learnVoltages(frequency);
+}
+
+boolean VoltageSweep::learnedSweep(uint32_t frequency)
+{
+    int32_t voltages[CALIBRATION_VALUES]; // mV
+    int learned_reflection = 0;
+    if (voltageMap.lookup(frequency, voltages, &learned_reflection) > VOLTAGE_SEED_DISTANCE)
+        return false;
+
+    float_t learned_tuning_voltage = voltages[0] / 1000.0;
+    float_t learned_matching_voltage = voltages[1] / 1000.0;
+    printInfo("Starting from learned voltages " + String(learned_tuning_voltage) + " V and " + String(learned_matching_voltage) + " V");
+
+    setFrequency(frequency);
+    sweepVoltages(VOLTAGE_SEED_STEP, max(learned_tuning_voltage - VOLTAGE_SEED_RANGE, 0.0), min(learned_tuning_voltage + VOLTAGE_SEED_RANGE, 5.0),
+                  max(learned_matching_voltage - VOLTAGE_SEED_RANGE, 0.0), min(learned_matching_voltage + VOLTAGE_SEED_RANGE, 5.0));
+
+    if (best_reflection < learned_reflection - VOLTAGE_REFLECTION_MARGIN)
+    {
+        printInfo("Matching is worse than learned, sweeping again");
+        return false;
+    }
+
+    return true;
+}
+
+void VoltageSweep::learnVoltages(uint32_t frequency)
+{
+    uint32_t RESONANCE_WINDOW = 1000000U; // 1MHz
+    uint32_t RESONANCE_STEP = 50000U;     // 50kHz
+
+    // Like the positions, the voltages are only learned if they set up a resonance close to the frequency, it is learned for the frequency it resonates at.
+    // The voltages have to be written before.
+    int32_t resonance_frequency = findCurrentResonanceFrequency(frequency - RESONANCE_WINDOW, frequency + RESONANCE_WINDOW, RESONANCE_STEP);
+    setFrequency(frequency);
+    if (resonance_frequency == 0 || (uint32_t)abs(resonance_frequency - (int32_t)frequency) > CALIBRATION_TOLERANCE)
+    {
+        printInfo("No resonance close to the frequency, the voltages are not learned");
+        return;
+    }
+
+    int32_t voltages[CALIBRATION_VALUES] = {(int32_t)lround(tuning_voltage * 1000), (int32_t)lround(matching_voltage * 1000)};
+    voltageMap.record(resonance_frequency, voltages, best_reflection);
 }
 
 void VoltageSweep::automaticSweep(uint32_t frequency)
@@ -87,6 +131,15 @@ void VoltageSweep::automaticSweep(uint32_t frequency)
     float MAX_VOLTAGE = 5.0;
     float MIN_VOLTAGE = 0.0;
 
+    // Around learned voltages a small local sweep is enough
+    if (learnedSweep(frequency))
+    {
+        adac.write_DAC(VM, matching_voltage);
+        adac.write_DAC(VT, tuning_voltage);
+        learnVoltages(frequency);
+        return;
+    }
+
     // First set the frequency 2 MHz below the target frequency
     uint32_t distance = 2000000;
     setFrequency(frequency - distance);
@@ -106,7 +159,8 @@ void VoltageSweep::automaticSweep(uint32_t frequency)
     float_t matching_range = 0.2;
     sweepVoltages(0.01, tuning_voltage - tuning_range, tuning_voltage + tuning_range, matching_voltage - matching_range, matching_voltage + matching_range);
 
-    if (tuning_voltage < 0.0 || matching_voltage < 0.0)
+    boolean valid = (tuning_voltage >= 0.0) && (matching_voltage >= 0.0);
+    if (!valid)
     {
         tuning_voltage = 0.0;
         matching_voltage = 0.0;
@@ -116,6 +170,9 @@ void VoltageSweep::automaticSweep(uint32_t frequency)
     // Finally we set the found voltages
     adac.write_DAC(VM, matching_voltage);
     adac.write_DAC(VT, tuning_voltage);
+
+    if (valid)
+        learnVoltages(frequency);
 }
 
 void VoltageSweep::sweepVoltages(float_t voltage_step, float_t tuning_start, float_t tuning_stop, float_t matching_start, float_t matching_stop)
@@ -124,26 +181,44 @@ void VoltageSweep::sweepVoltages(float_t voltage_step, float_t tuning_start, flo
     // We want to maximize the reflection value, so we start with zero
     float_t minimum_reflection = 0.0;
 
+    // The number of voltages per axis, the small offset makes sure the stop voltage is included despite rounding errors
+    int tuning_voltages = floor((tuning_stop - tuning_start) / voltage_step + 1e-3) + 1;
+    int matching_voltages = floor((matching_stop - matching_start) / voltage_step + 1e-3) + 1;
+    int best_row = 0;
+    int best_column = 0;
+    best_reflection = 0;
+
     // This bruteforces the optimum voltage for tuning and matching.
-    for (float_t c_tuning_voltage = tuning_start; c_tuning_voltage <= tuning_stop; c_tuning_voltage += voltage_step)
+    for (int row = 0; row < tuning_voltages; row++)
     {
-        for (float_t c_matching_voltage = matching_start; c_matching_voltage <= matching_stop; c_matching_voltage += voltage_step)
+        float_t c_tuning_voltage = tuning_start + row * voltage_step;
+
+        // Every second row is swept backwards so the matching voltage does not jump back to the start of the row
+        for (int i = 0; i < matching_voltages; i++)
         {
+            int column = (row % 2 == 0) ? i : matching_voltages - 1 - i;
+            float_t c_matching_voltage = matching_start + column * voltage_step;
+
             // Set the tuning and matching voltage
             adac.write_DAC(VT, c_tuning_voltage);
             adac.write_DAC(VM, c_matching_voltage);
+            scheduler.yield();
 
             // Measure the reflection at the given frequency
             int reflection = readReflection(AVERAGES);
 
             // If the reflection is lower than the current minimum, we have found a new minimum
-            if (reflection > minimum_reflection)
+            // On equal reflection the lower matching voltage of the row wins, so the result is the same as for a row by row sweep
+            if ((reflection > minimum_reflection) || ((reflection == minimum_reflection) && (row == best_row) && (column < best_column)))
             {
                 minimum_reflection = reflection;
+                best_reflection = reflection;
                 tuning_voltage = c_tuning_voltage;
                 matching_voltage = c_matching_voltage;
+                best_row = row;
+                best_column = column;
                 // If the returnloss is better than 14dB, we can stop the voltage sweep
-                // float_t reflection_db = (reflection - 900) / 30.0;
+                // float_t reflection_db = reflectionToDb(reflection);
                 // if (reflection_db > 14)
                 //    return;
             }
@@ -168,4 +243,5 @@ void VoltageSweep::printHelp()
     Serial.println("Syntax: v<frequency in MHz>");
     Serial.println("Example: v100");
     Serial.println("This will perform a voltage sweep at 100 MHz and will return the optimum tuning and matching voltages for this frequency.");
+    Serial.println("The found voltages are learned, close to learned frequencies only a small sweep around the learned voltages is done.");
 }
\ No newline at end of file
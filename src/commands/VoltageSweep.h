@@ -3,6 +3,14 @@
 
 #include "Command.h"
 
+// Learned voltages closer than this to the frequency are used as starting point
+#define VOLTAGE_SEED_DISTANCE 2000000U // 2MHz
+// Range and step of the local sweep around the learned voltages
+#define VOLTAGE_SEED_RANGE 0.05 // V
+#define VOLTAGE_SEED_STEP 0.01  // V
+// The local sweep is accepted if the reflection is at most this much lower than learned
+#define VOLTAGE_REFLECTION_MARGIN 30 // mV, ~1dB
+
 /**
  * @brief This class is used to perform a voltage sweep. This means the return loss at a given frequency will be measured and the tuning and matching voltage with the lowest return loss will be found.
  */
@@ -17,8 +25,11 @@ private:
     void sweepVoltages(float_t voltage_step, float_t tuning_start, float_t tuning_stop, float_t matching_start, float_t matching_stop);
     void automaticSweep(uint32_t frequency);
     void presetVoltages(uint32_t frequency, float_t tuning_voltage, float_t matching_voltage);
+    boolean learnedSweep(uint32_t frequency);
+    void learnVoltages(uint32_t frequency);
     float_t matching_voltage;
     float_t tuning_voltage;
+    int best_reflection;
 };
 
 #endif
\ No newline at end of file
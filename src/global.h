@@ -9,8 +9,16 @@
 #include "AD5593R.h"
 
 #include "Pins.h" // Pins are defined here
+#include "StepGenerator.h"
 #include "Stepper.h"
 #include "Positions.h" // Calibrated frequency positions are defined her
+#include "Scheduler.h"
+#include "SweepStore.h"
+#include "CalibrationMap.h"
+#include "SensitivityMatrix.h"
+#include "MeasurementCache.h"
+#include "MotionService.h"
+#include "SettleModel.h"
 
 // Global variables for the adac module
 #define MAGNITUDE 0
@@ -18,12 +26,32 @@
 #define VT 2
 #define VM 3
 
+// Conversion of the AD8302 magnitude output to return loss, 900mV at 0dB and 30mV/dB
+#define AD8302_MAGNITUDE_OFFSET 900
+#define AD8302_MAGNITUDE_SLOPE 30.0
+
+// Baud rate the serial link starts with, faster rates can be negotiated with the 'b' command
+#define DEFAULT_BAUD_RATE 115200U
+
 // We want these objects to be accessible from all files
 extern ADF4351 adf4351;
 extern Stepper tuner;
 extern Stepper matcher;
 extern AD5593R adac;
+extern Scheduler scheduler;
+extern SweepStore sweepStore;
+extern CalibrationMap positionMap;
+extern CalibrationMap voltageMap;
+extern CalibrationMap anticlockwisePhaseMap;
+extern CalibrationMap clockwisePhaseMap;
+extern SensitivityMatrix sensitivity;
+extern MeasurementCache measurementCache;
+extern MotionService motion;
+extern SettleModel settleModel;
 
 extern Filter active_filter;
 
+// Positions are only meaningful after the steppers have been homed
+extern boolean homed;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+"""Reference decoder for the compact frequency sweep format of the ATM system.
+
+The format is described in src/SweepEncoder.h. The compact sweep is requested with
+f<start frequency>f<stop frequency>f<frequency step>c
+
+Example:
+    import serial
+    from sweep_decoder import read_compact_sweep
+
+    port = serial.Serial("/dev/ttyUSB0", 115200)
+    port.write(b"f80000000f90000000f50000c\n")
+    port.readline()  # c confirmation
+    port.readline()  # iStarted frequency sweep
+    frequencies, reflections, phases, filters = read_compact_sweep(port)
+"""
+
+
+def _read_line(port):
+    return port.readline().decode("ascii").strip()
+
+
+def _read_varint(port):
+    value = 0
+    shift = 0
+    while True:
+        byte = port.read(1)[0]
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value
+        shift += 7
+
+
+def _unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def parse_header(line):
+    """Parses x<start>,<step>,<count>,<averages>s<index>,<fg>... into its values."""
+    if not line.startswith("x"):
+        raise ValueError("Not a compact sweep header: %s" % line)
+
+    fields = line[1:].split("s")
+    start, step, count, averages = (int(value) for value in fields[0].split(","))
+    filters = [tuple(int(value) for value in field.split(",")) for field in fields[1:]]
+    return start, step, count, averages, filters
+
+
+def read_compact_sweep(port):
+    """Reads one compact sweep from a serial port like object.
+
+    Informational lines (starting with i) before the header are skipped.
+    Returns the frequencies in Hz, the reflections and phases in mV and the
+    filter switch points as (point index, filter fg) tuples.
+    """
+    line = _read_line(port)
+    while line.startswith("i"):
+        line = _read_line(port)
+
+    start, step, count, averages, filters = parse_header(line)
+
+    frequencies = [start + i * step for i in range(count)]
+    reflections = []
+    phases = []
+    reflection = 0
+    phase = 0
+    for _ in range(count):
+        reflection += _unzigzag(_read_varint(port))
+        phase += _unzigzag(_read_varint(port))
+        reflections.append(reflection)
+        phases.append(phase)
+
+    return frequencies, reflections, phases, filters